@@ -0,0 +1,316 @@
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Microbenchmarks for the per-way code of AdminHandler. The relations and
+ * ways are built in memory, so no time is spent reading input and changes
+ * to the hot paths show up even when end-to-end runs are dominated by I/O.
+ * Lines that make it to an output file are written to /dev/null.
+ *
+ * Besides the usual timings each benchmark reports the time and the
+ * number of heap allocations per way (or relation).
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+
+#include "adminhandler.hpp"
+#include "ewkb.hpp"
+#include "lineoutput.hpp"
+#include "options.hpp"
+#include "projection.hpp"
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+} // anonymous namespace
+
+// Count every allocation, the other forms of new and delete end up here
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+namespace {
+
+constexpr size_t num_ways = 10000;
+constexpr size_t nodes_per_way = 20;
+
+/**
+ * Boundary ways which share their end nodes with the next way, and
+ * relations with four consecutive ways each, so most ways have two
+ * parents. Some ways are disputed or maritime and every tenth relation is
+ * an admin_level 2 one, so all code paths are taken.
+ */
+struct TestData
+{
+    osmium::memory::Buffer relations{1024 * 1024};
+    osmium::memory::Buffer ways{4 * 1024 * 1024};
+    size_t num_relations = 0;
+
+    TestData()
+    {
+        for (size_t i = 1; i <= num_ways; ++i) {
+            add_way(static_cast<osmium::object_id_type>(i));
+        }
+        for (size_t i = 1; i + 2 <= num_ways; i += 2) {
+            add_relation(static_cast<osmium::object_id_type>(i));
+            ++num_relations;
+        }
+    }
+
+    void add_way(osmium::object_id_type id)
+    {
+        {
+            osmium::builder::WayBuilder builder{ways};
+            builder.set_id(id);
+            builder.set_version(1);
+            {
+                osmium::builder::WayNodeListBuilder nodes{builder};
+                const osmium::object_id_type first =
+                    (id - 1) * (nodes_per_way - 1) + 1;
+                for (size_t n = 0; n < nodes_per_way; ++n) {
+                    const osmium::object_id_type node_id = first + n;
+                    nodes.add_node_ref(
+                        node_id, osmium::Location{-170.0 + node_id * 1e-4,
+                                                  10.0 + (node_id % 7) * 0.01});
+                }
+            }
+            osmium::builder::TagListBuilder tags{builder};
+            tags.add_tag("boundary", "administrative");
+            tags.add_tag("admin_level", id % 10 == 0 ? "2" : "4");
+            tags.add_tag("source", "survey");
+            if (id % 50 == 0) {
+                tags.add_tag("disputed", "yes");
+            }
+            if (id % 70 == 0) {
+                tags.add_tag("maritime", "yes");
+            }
+        }
+        ways.commit();
+    }
+
+    void add_relation(osmium::object_id_type first_way)
+    {
+        {
+            osmium::builder::RelationBuilder builder{relations};
+            builder.set_id(first_way);
+            builder.set_version(1);
+            {
+                osmium::builder::RelationMemberListBuilder members{builder};
+                for (osmium::object_id_type way_id = first_way;
+                     way_id < first_way + 4 &&
+                     way_id <= static_cast<osmium::object_id_type>(num_ways);
+                     ++way_id) {
+                    members.add_member(osmium::item_type::way, way_id,
+                                       "outer");
+                }
+            }
+            osmium::builder::TagListBuilder tags{builder};
+            tags.add_tag("type", "boundary");
+            tags.add_tag("boundary", "administrative");
+            tags.add_tag("admin_level", first_way % 20 == 1 ? "2" : "4");
+            tags.add_tag("name", "Relation " + std::to_string(first_way));
+        }
+        relations.commit();
+    }
+};
+
+const TestData &test_data()
+{
+    static const TestData data;
+    return data;
+}
+
+/// Feeds the relations of the test data to the handler like pass 1 does
+void read_relations(AdminHandler &handler)
+{
+    const TestData &data = test_data();
+    for (auto it = data.relations.cbegin<osmium::Relation>();
+         it != data.relations.cend<osmium::Relation>(); ++it) {
+        handler.relation(*it);
+    }
+    handler.sort_way_relations();
+}
+
+OutputSpec null_output(double tolerance)
+{
+    return OutputSpec{"/dev/null", BatchProjection::epsg_mercator, tolerance,
+                      0, 1, shard_method::id};
+}
+
+/**
+ * Sets the per item counters. Call after the benchmark loop with the
+ * allocation count from before it.
+ */
+void report(benchmark::State &state, const std::string &item,
+            size_t items_per_iteration, uint64_t allocations_before)
+{
+    const double items =
+        static_cast<double>(state.iterations()) * items_per_iteration;
+    state.SetItemsProcessed(state.iterations() * items_per_iteration);
+    state.counters["time/" + item] = benchmark::Counter(
+        static_cast<double>(items_per_iteration),
+        benchmark::Counter::kIsIterationInvariantRate |
+            benchmark::Counter::kInvert);
+    state.counters["allocs/" + item] =
+        (allocations.load() - allocations_before) / items;
+}
+
+void BM_relation(benchmark::State &state)
+{
+    const TestData &data = test_data();
+    const std::vector<LineOutput *> outputs;
+    const uint64_t allocations_before = allocations.load();
+    for (auto _ : state) {
+        AdminHandler handler{outputs};
+        for (auto it = data.relations.cbegin<osmium::Relation>();
+             it != data.relations.cend<osmium::Relation>(); ++it) {
+            handler.relation(*it);
+        }
+        benchmark::DoNotOptimize(handler.relations_count());
+    }
+    report(state, "relation", data.num_relations, allocations_before);
+}
+BENCHMARK(BM_relation);
+
+void BM_pass2_way(benchmark::State &state)
+{
+    const TestData &data = test_data();
+    const std::vector<LineOutput *> outputs;
+    AdminHandler handler{outputs};
+    read_relations(handler);
+
+    const uint64_t allocations_before = allocations.load();
+    for (auto _ : state) {
+        handler.get_ways().clear();
+        for (auto it = data.ways.cbegin<osmium::Way>();
+             it != data.ways.cend<osmium::Way>(); ++it) {
+            handler.m_handler_pass2.way(*it);
+        }
+    }
+    report(state, "way", num_ways, allocations_before);
+}
+BENCHMARK(BM_pass2_way);
+
+// Argument: 0 for text output, 1 for PostgreSQL binary COPY output
+void BM_way(benchmark::State &state)
+{
+    const TestData &data = test_data();
+    LineOutput output{null_output(0), state.range(0)
+                                          ? output_format::pgcopy_binary
+                                          : output_format::text};
+    AdminHandler handler{{&output}};
+    read_relations(handler);
+    handler.write_header();
+
+    const uint64_t allocations_before = allocations.load();
+    for (auto _ : state) {
+        for (auto it = data.ways.cbegin<osmium::Way>();
+             it != data.ways.cend<osmium::Way>(); ++it) {
+            handler.way(*it);
+        }
+    }
+    report(state, "way", num_ways, allocations_before);
+}
+BENCHMARK(BM_way)->Arg(0)->Arg(1);
+
+// Argument: simplification tolerance in meters
+void BM_write_way(benchmark::State &state)
+{
+    const TestData &data = test_data();
+    LineOutput output{null_output(static_cast<double>(state.range(0))),
+                      output_format::text};
+    AdminHandler handler{{&output}};
+    read_relations(handler);
+
+    AdminHandler::GeometryBuilder builder;
+    std::vector<std::string> lines(1);
+    std::string errors;
+    const uint64_t allocations_before = allocations.load();
+    for (auto _ : state) {
+        lines[0].clear();
+        for (auto it = data.ways.cbegin<osmium::Way>();
+             it != data.ways.cend<osmium::Way>(); ++it) {
+            handler.write_way(*it, builder, lines, errors);
+        }
+        benchmark::DoNotOptimize(lines[0].data());
+    }
+    report(state, "way", num_ways, allocations_before);
+}
+BENCHMARK(BM_write_way)->Arg(0)->Arg(10);
+
+void BM_linestring(benchmark::State &state)
+{
+    const TestData &data = test_data();
+    const BatchProjection projection{BatchProjection::epsg_mercator};
+    EWKBLineStringBuilder builder;
+    const uint64_t allocations_before = allocations.load();
+    for (auto _ : state) {
+        for (auto it = data.ways.cbegin<osmium::Way>();
+             it != data.ways.cend<osmium::Way>(); ++it) {
+            builder.set_nodes(it->nodes());
+            benchmark::DoNotOptimize(builder.linestring(projection).data());
+        }
+    }
+    report(state, "way", num_ways, allocations_before);
+}
+BENCHMARK(BM_linestring);
+
+void BM_escape(benchmark::State &state)
+{
+    const TestData &data = test_data();
+    const uint64_t allocations_before = allocations.load();
+    for (auto _ : state) {
+        for (auto it = data.ways.cbegin<osmium::Way>();
+             it != data.ways.cend<osmium::Way>(); ++it) {
+            for (const auto &tag : it->tags()) {
+                benchmark::DoNotOptimize(AdminHandler::escape(tag.value()));
+            }
+        }
+    }
+    report(state, "way", num_ways, allocations_before);
+}
+BENCHMARK(BM_escape);
+
+} // anonymous namespace
+
+BENCHMARK_MAIN();
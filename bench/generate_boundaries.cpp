@@ -0,0 +1,565 @@
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Writes a synthetic, sorted OSM file with boundaries laid out on a grid
+ * for benchmarking osmborder_filter and osmborder.
+ *
+ * The map is divided into GRID x GRID cells. Every cell is an admin_level 4
+ * relation and every BLOCK x BLOCK group of cells forms an admin_level 2
+ * relation. Each cell edge is one way shared by the relations on both
+ * sides and the grid corners are nodes shared by up to four ways. Untagged
+ * nodes and highway ways are added as background noise for the filter to
+ * drop.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <getopt.h>
+#include <initializer_list>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/any_compression.hpp>
+#include <osmium/io/any_output.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include "return_codes.hpp"
+
+namespace {
+
+struct Parameters
+{
+    unsigned int grid = 100;
+    unsigned int block = 4;
+    unsigned int way_nodes = 20;
+    double jitter = 0.2;
+    double disputed = 0.01;
+    unsigned int noise_nodes = 0;
+    unsigned int noise_ways = 0;
+    unsigned int seed = 1;
+};
+
+void print_help()
+{
+    std::cout
+        << "generate_boundaries [OPTIONS] OUTFILE\n"
+        << "\nOptions:\n"
+        << "  -h, --help              - This help message\n"
+        << "  -g, --grid=N            - Grid of NxN admin_level 4 relations "
+           "(default: 100)\n"
+        << "  -b, --block=N           - NxN cells per admin_level 2 relation "
+           "(default: 4)\n"
+        << "  -l, --way-nodes=N       - Nodes per boundary way, at least 2 "
+           "(default: 20)\n"
+        << "  -j, --jitter=FRACTION   - Offset of way nodes from the grid "
+           "lines as\n"
+        << "                            a fraction of the cell size "
+           "(default: 0.2)\n"
+        << "  -d, --disputed=FRACTION - Fraction of ways tagged disputed "
+           "(default: 0.01)\n"
+        << "  -n, --noise-nodes=N     - Untagged nodes outside of "
+           "boundaries\n"
+        << "  -w, --noise-ways=N      - Highway ways outside of boundaries, "
+           "each\n"
+        << "                            with their own way-nodes nodes\n"
+        << "  -s, --seed=N            - Random seed (default: 1)\n"
+        << "\nWays on the outer edge of the grid are tagged maritime. The "
+           "output is\n"
+        << "sorted by type and ID like planet files are.\n";
+}
+
+unsigned int get_count(const char *arg, unsigned int min)
+{
+    char *end;
+    const long value = std::strtol(arg, &end, 10);
+    if (*end != '\0' || value < long{min} || value > 1000000000) {
+        std::cerr << "Invalid count: " << arg << "\n";
+        std::exit(return_code_cmdline);
+    }
+    return static_cast<unsigned int>(value);
+}
+
+double get_fraction(const char *arg)
+{
+    char *end;
+    const double value = std::strtod(arg, &end);
+    if (*end != '\0' || !(value >= 0 && value <= 1)) {
+        std::cerr << "Invalid fraction: " << arg << "\n";
+        std::exit(return_code_cmdline);
+    }
+    return value;
+}
+
+/**
+ * Collects objects into buffers and hands full buffers to the writer. The
+ * buffers grow if needed, so long ways and large block relations fit.
+ */
+class BufferedWriter
+{
+    static constexpr size_t buffer_size = 1024 * 1024;
+
+    osmium::io::Writer &m_writer;
+    osmium::memory::Buffer m_buffer;
+
+public:
+    explicit BufferedWriter(osmium::io::Writer &writer)
+    : m_writer(writer),
+      m_buffer(buffer_size, osmium::memory::Buffer::auto_grow::yes)
+    {}
+
+    osmium::memory::Buffer &buffer() { return m_buffer; }
+
+    void commit()
+    {
+        m_buffer.commit();
+        if (m_buffer.committed() >= buffer_size - 64 * 1024) {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        if (m_buffer.committed() > 0) {
+            m_writer(std::move(m_buffer));
+            m_buffer = osmium::memory::Buffer{
+                buffer_size, osmium::memory::Buffer::auto_grow::yes};
+        }
+    }
+};
+
+/**
+ * Computes the IDs and locations of the grid. Node and way IDs are handed
+ * out in the order the objects are written, so the output is sorted
+ * without holding anything in memory.
+ */
+class Grid
+{
+    const Parameters &m_params;
+    const unsigned int m_size;
+    const unsigned int m_inner;
+
+    static constexpr double min_lon = -179.0;
+    static constexpr double max_lon = 179.0;
+    static constexpr double min_lat = -80.0;
+    static constexpr double max_lat = 80.0;
+
+public:
+    explicit Grid(const Parameters &params)
+    : m_params(params), m_size(params.grid), m_inner(params.way_nodes - 2)
+    {}
+
+    uint64_t corners() const
+    {
+        return uint64_t{m_size + 1} * (m_size + 1);
+    }
+
+    /// Horizontal edges come first, then vertical ones
+    uint64_t horizontal_edges() const
+    {
+        return uint64_t{m_size + 1} * m_size;
+    }
+
+    uint64_t edges() const { return 2 * horizontal_edges(); }
+
+    uint64_t boundary_nodes() const { return corners() + edges() * m_inner; }
+
+    uint64_t cells() const { return uint64_t{m_size} * m_size; }
+
+    unsigned int blocks_per_side() const
+    {
+        return (m_size + m_params.block - 1) / m_params.block;
+    }
+
+    double lon(double col) const
+    {
+        return min_lon + (max_lon - min_lon) * col / m_size;
+    }
+
+    double lat(double row) const
+    {
+        return min_lat + (max_lat - min_lat) * row / m_size;
+    }
+
+    osmium::object_id_type corner_id(unsigned int row, unsigned int col) const
+    {
+        return 1 + row * int64_t{m_size + 1} + col;
+    }
+
+    /// Way ID of the edge from corner (row, col) to (row, col + 1)
+    osmium::object_id_type h_edge_id(unsigned int row, unsigned int col) const
+    {
+        return 1 + row * int64_t{m_size} + col;
+    }
+
+    /// Way ID of the edge from corner (row, col) to (row + 1, col)
+    osmium::object_id_type v_edge_id(unsigned int row, unsigned int col) const
+    {
+        return 1 + horizontal_edges() + row * int64_t{m_size + 1} + col;
+    }
+
+    /// ID of the first node between the corners of an edge
+    osmium::object_id_type inner_node_id(osmium::object_id_type way_id) const
+    {
+        return 1 + corners() + (way_id - 1) * m_inner;
+    }
+
+    /// Whether the edge separates two blocks or lies on the outside
+    bool h_edge_is_block_edge(unsigned int row) const
+    {
+        return row % m_params.block == 0 || row == m_size;
+    }
+
+    bool v_edge_is_block_edge(unsigned int col) const
+    {
+        return col % m_params.block == 0 || col == m_size;
+    }
+};
+
+void add_tags(osmium::builder::Builder &parent,
+              std::initializer_list<std::pair<const char *, const char *>> tags)
+{
+    osmium::builder::TagListBuilder builder{parent};
+    for (const auto &tag : tags) {
+        builder.add_tag(tag.first, tag.second);
+    }
+}
+
+void add_node(BufferedWriter &out, osmium::object_id_type id, double lon,
+              double lat)
+{
+    {
+        osmium::builder::NodeBuilder builder{out.buffer()};
+        builder.set_id(id);
+        builder.set_version(1);
+        builder.set_location(osmium::Location{lon, lat});
+    }
+    out.commit();
+}
+
+void add_edge(BufferedWriter &out, const Grid &grid,
+              osmium::object_id_type way_id, osmium::object_id_type from,
+              osmium::object_id_type to, unsigned int inner, bool block_edge,
+              bool outer_edge, bool disputed)
+{
+    {
+        osmium::builder::WayBuilder builder{out.buffer()};
+        builder.set_id(way_id);
+        builder.set_version(1);
+        {
+            osmium::builder::WayNodeListBuilder nodes{builder};
+            nodes.add_node_ref(from);
+            const auto first = grid.inner_node_id(way_id);
+            for (unsigned int i = 0; i < inner; ++i) {
+                nodes.add_node_ref(first + i);
+            }
+            nodes.add_node_ref(to);
+        }
+        osmium::builder::TagListBuilder tags{builder};
+        tags.add_tag("boundary", "administrative");
+        tags.add_tag("admin_level", block_edge ? "2" : "4");
+        if (outer_edge) {
+            tags.add_tag("maritime", "yes");
+        }
+        if (disputed) {
+            tags.add_tag("disputed", "yes");
+        }
+    }
+    out.commit();
+}
+
+void add_relation(BufferedWriter &out, osmium::object_id_type id,
+                  const char *admin_level, const std::string &name,
+                  const std::vector<osmium::object_id_type> &way_ids)
+{
+    {
+        osmium::builder::RelationBuilder builder{out.buffer()};
+        builder.set_id(id);
+        builder.set_version(1);
+        {
+            osmium::builder::RelationMemberListBuilder members{builder};
+            for (const auto way_id : way_ids) {
+                members.add_member(osmium::item_type::way, way_id, "outer");
+            }
+        }
+        osmium::builder::TagListBuilder tags{builder};
+        tags.add_tag("type", "boundary");
+        tags.add_tag("boundary", "administrative");
+        tags.add_tag("admin_level", admin_level);
+        tags.add_tag("name", name);
+    }
+    out.commit();
+}
+
+void write_nodes(BufferedWriter &out, const Parameters &params,
+                 const Grid &grid, std::mt19937_64 &gen)
+{
+    const unsigned int size = params.grid;
+    const unsigned int inner = params.way_nodes - 2;
+    std::uniform_real_distribution<double> offset{-params.jitter / 2,
+                                                  params.jitter / 2};
+
+    for (unsigned int row = 0; row <= size; ++row) {
+        for (unsigned int col = 0; col <= size; ++col) {
+            add_node(out, grid.corner_id(row, col), grid.lon(col),
+                     grid.lat(row));
+        }
+    }
+
+    // The nodes between the corners wander off the grid line, but never
+    // far enough to cross another edge.
+    for (unsigned int row = 0; row <= size; ++row) {
+        for (unsigned int col = 0; col < size; ++col) {
+            const auto first = grid.inner_node_id(grid.h_edge_id(row, col));
+            for (unsigned int i = 0; i < inner; ++i) {
+                const double along = col + (i + 1.0) / (inner + 1);
+                const double across =
+                    (row == 0 || row == size) ? row : row + offset(gen);
+                add_node(out, first + i, grid.lon(along), grid.lat(across));
+            }
+        }
+    }
+    for (unsigned int row = 0; row < size; ++row) {
+        for (unsigned int col = 0; col <= size; ++col) {
+            const auto first = grid.inner_node_id(grid.v_edge_id(row, col));
+            for (unsigned int i = 0; i < inner; ++i) {
+                const double along = row + (i + 1.0) / (inner + 1);
+                const double across =
+                    (col == 0 || col == size) ? col : col + offset(gen);
+                add_node(out, first + i, grid.lon(across), grid.lat(along));
+            }
+        }
+    }
+
+    std::uniform_real_distribution<double> position{0, double(size)};
+    osmium::object_id_type id = 1 + grid.boundary_nodes();
+    for (unsigned int i = 0; i < params.noise_nodes; ++i) {
+        add_node(out, id++, grid.lon(position(gen)), grid.lat(position(gen)));
+    }
+
+    // Noise ways are short straight lines of their own nodes
+    for (unsigned int i = 0; i < params.noise_ways; ++i) {
+        const double col = position(gen);
+        const double row = position(gen);
+        for (unsigned int n = 0; n < params.way_nodes; ++n) {
+            add_node(out, id++, grid.lon(col + n * 0.001),
+                     grid.lat(row + n * 0.001));
+        }
+    }
+}
+
+void write_ways(BufferedWriter &out, const Parameters &params,
+                const Grid &grid, std::mt19937_64 &gen)
+{
+    const unsigned int size = params.grid;
+    const unsigned int inner = params.way_nodes - 2;
+    std::bernoulli_distribution disputed{params.disputed};
+
+    for (unsigned int row = 0; row <= size; ++row) {
+        for (unsigned int col = 0; col < size; ++col) {
+            add_edge(out, grid, grid.h_edge_id(row, col),
+                     grid.corner_id(row, col), grid.corner_id(row, col + 1),
+                     inner, grid.h_edge_is_block_edge(row),
+                     row == 0 || row == size, disputed(gen));
+        }
+    }
+    for (unsigned int row = 0; row < size; ++row) {
+        for (unsigned int col = 0; col <= size; ++col) {
+            add_edge(out, grid, grid.v_edge_id(row, col),
+                     grid.corner_id(row, col), grid.corner_id(row + 1, col),
+                     inner, grid.v_edge_is_block_edge(col),
+                     col == 0 || col == size, disputed(gen));
+        }
+    }
+
+    osmium::object_id_type node_id =
+        1 + grid.boundary_nodes() + params.noise_nodes;
+    osmium::object_id_type way_id = 1 + grid.edges();
+    for (unsigned int i = 0; i < params.noise_ways; ++i) {
+        {
+            osmium::builder::WayBuilder builder{out.buffer()};
+            builder.set_id(way_id++);
+            builder.set_version(1);
+            {
+                osmium::builder::WayNodeListBuilder nodes{builder};
+                for (unsigned int n = 0; n < params.way_nodes; ++n) {
+                    nodes.add_node_ref(node_id++);
+                }
+            }
+            add_tags(builder, {{"highway", "residential"}});
+        }
+        out.commit();
+    }
+}
+
+void write_relations(BufferedWriter &out, const Parameters &params,
+                     const Grid &grid)
+{
+    const unsigned int size = params.grid;
+    std::vector<osmium::object_id_type> way_ids;
+
+    for (unsigned int row = 0; row < size; ++row) {
+        for (unsigned int col = 0; col < size; ++col) {
+            way_ids = {grid.h_edge_id(row, col), grid.v_edge_id(row, col + 1),
+                       grid.h_edge_id(row + 1, col), grid.v_edge_id(row, col)};
+            add_relation(out, 1 + row * int64_t{size} + col, "4",
+                         "Cell " + std::to_string(row) + "/" +
+                             std::to_string(col),
+                         way_ids);
+        }
+    }
+
+    // Blocks on the top and right of the grid are cut off when the grid
+    // size is not a multiple of the block size.
+    const unsigned int blocks = grid.blocks_per_side();
+    for (unsigned int brow = 0; brow < blocks; ++brow) {
+        for (unsigned int bcol = 0; bcol < blocks; ++bcol) {
+            const unsigned int row0 = brow * params.block;
+            const unsigned int col0 = bcol * params.block;
+            const unsigned int row1 = std::min(row0 + params.block, size);
+            const unsigned int col1 = std::min(col0 + params.block, size);
+            way_ids.clear();
+            for (unsigned int col = col0; col < col1; ++col) {
+                way_ids.push_back(grid.h_edge_id(row0, col));
+            }
+            for (unsigned int row = row0; row < row1; ++row) {
+                way_ids.push_back(grid.v_edge_id(row, col1));
+            }
+            for (unsigned int col = col1; col > col0; --col) {
+                way_ids.push_back(grid.h_edge_id(row1, col - 1));
+            }
+            for (unsigned int row = row1; row > row0; --row) {
+                way_ids.push_back(grid.v_edge_id(row - 1, col0));
+            }
+            add_relation(out, 1 + grid.cells() + brow * int64_t{blocks} + bcol,
+                         "2",
+                         "Block " + std::to_string(brow) + "/" +
+                             std::to_string(bcol),
+                         way_ids);
+        }
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] = {
+        {"block", required_argument, 0, 'b'},
+        {"disputed", required_argument, 0, 'd'},
+        {"grid", required_argument, 0, 'g'},
+        {"help", no_argument, 0, 'h'},
+        {"jitter", required_argument, 0, 'j'},
+        {"way-nodes", required_argument, 0, 'l'},
+        {"noise-nodes", required_argument, 0, 'n'},
+        {"seed", required_argument, 0, 's'},
+        {"noise-ways", required_argument, 0, 'w'},
+        {0, 0, 0, 0}};
+
+    Parameters params;
+    while (true) {
+        const int c =
+            getopt_long(argc, argv, "b:d:g:hj:l:n:s:w:", long_options, 0);
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'b':
+            params.block = get_count(optarg, 1);
+            break;
+        case 'd':
+            params.disputed = get_fraction(optarg);
+            break;
+        case 'g':
+            params.grid = get_count(optarg, 1);
+            break;
+        case 'h':
+            print_help();
+            std::exit(return_code_ok);
+        case 'j':
+            params.jitter = get_fraction(optarg);
+            break;
+        case 'l':
+            params.way_nodes = get_count(optarg, 2);
+            break;
+        case 'n':
+            params.noise_nodes = get_count(optarg, 0);
+            break;
+        case 's':
+            params.seed = get_count(optarg, 0);
+            break;
+        case 'w':
+            params.noise_ways = get_count(optarg, 0);
+            break;
+        default:
+            std::exit(return_code_cmdline);
+        }
+    }
+
+    if (optind != argc - 1) {
+        std::cerr << "Usage: generate_boundaries [OPTIONS] OUTFILE\n";
+        std::exit(return_code_cmdline);
+    }
+
+    const Grid grid{params};
+
+    osmium::io::Header header;
+    header.set("generator", "generate_boundaries");
+    header.set("sorting", "Type_then_ID");
+    header.add_box(osmium::Box{-180.0, -90.0, 180.0, 90.0});
+
+    try {
+        osmium::io::Writer writer{argv[optind], header,
+                                  osmium::io::overwrite::allow};
+        BufferedWriter out{writer};
+        std::mt19937_64 gen{params.seed};
+
+        write_nodes(out, params, grid, gen);
+        write_ways(out, params, grid, gen);
+        write_relations(out, params, grid);
+
+        out.flush();
+        writer.close();
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        std::exit(return_code_fatal);
+    }
+
+    std::cerr << grid.cells() + uint64_t{grid.blocks_per_side()} *
+                                    grid.blocks_per_side()
+              << " relations, " << grid.edges() + params.noise_ways
+              << " ways, "
+              << grid.boundary_nodes() + params.noise_nodes +
+                     uint64_t{params.noise_ways} * params.way_nodes
+              << " nodes\n";
+}
@@ -0,0 +1,139 @@
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Measures the throughput of the hex encoding kernels on EWKB sized
+ * inputs and compares them with the nibble-at-a-time encoding osmium's
+ * WKBFactory uses.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hex.hpp"
+
+namespace {
+
+// The encoding used before, one lookup per nibble
+void hex_encode_nibbles(const char *data, size_t size, char *out)
+{
+    static const char lookup_hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < size; ++i) {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+        *out++ = lookup_hex[c >> 4];
+        *out++ = lookup_hex[c & 0xf];
+    }
+}
+
+typedef void (*hex_encode_func)(const char *, size_t, char *);
+
+void run(const char *name, hex_encode_func func,
+         const std::vector<std::string> &inputs, const std::string &expected)
+{
+    size_t total = 0;
+    for (const auto &input : inputs) {
+        total += input.size();
+    }
+    std::string out(total * 2, '\0');
+
+    // Check the result before timing anything
+    size_t pos = 0;
+    for (const auto &input : inputs) {
+        func(input.data(), input.size(), &out[pos]);
+        pos += input.size() * 2;
+    }
+    if (out != expected) {
+        std::cerr << name << ": wrong result\n";
+        std::exit(1);
+    }
+
+    const int rounds = 50;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        pos = 0;
+        for (const auto &input : inputs) {
+            func(input.data(), input.size(), &out[pos]);
+            pos += input.size() * 2;
+        }
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    std::cout << std::left << std::setw(12) << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(1)
+              << (total * rounds / elapsed.count() / (1024 * 1024))
+              << " MB/s\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    // Megabytes of input, less makes a quick correctness test
+    const long megabytes = (argc > 1) ? std::atol(argv[1]) : 64;
+    if (megabytes <= 0) {
+        std::cerr << "Usage: hex_bench [MEGABYTES]\n";
+        return 2;
+    }
+
+    // EWKB linestrings are 13 header bytes plus 16 bytes per point. Most
+    // boundary ways have a few dozen points, some have thousands.
+    std::mt19937 gen{42};
+    std::geometric_distribution<int> points{0.02};
+    std::vector<std::string> inputs;
+    size_t total = 0;
+    while (total < static_cast<size_t>(megabytes) * 1024 * 1024) {
+        std::string input(13 + 16 * (2 + points(gen)), '\0');
+        for (auto &c : input) {
+            c = static_cast<char>(gen());
+        }
+        total += input.size();
+        inputs.push_back(std::move(input));
+    }
+
+    std::string expected(total * 2, '\0');
+    size_t pos = 0;
+    for (const auto &input : inputs) {
+        hex_encode_nibbles(input.data(), input.size(), &expected[pos]);
+        pos += input.size() * 2;
+    }
+
+    std::cout << inputs.size() << " geometries, " << total / (1024 * 1024)
+              << " MB, hex_encode() uses '" << hex_encode_kernel()
+              << "'\n";
+
+    run("nibbles", hex_encode_nibbles, inputs, expected);
+    run("scalar", hex_encode_scalar, inputs, expected);
+#ifdef OSMBORDER_HEX_X86
+    if (hex_encode_has_sse2()) {
+        run("sse2", hex_encode_sse2, inputs, expected);
+    }
+    if (hex_encode_has_avx2()) {
+        run("avx2", hex_encode_avx2, inputs, expected);
+    }
+#endif
+    run("hex_encode", hex_encode, inputs, expected);
+}
@@ -0,0 +1,133 @@
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Compares mercator_project() with osmium's MercatorProjection, which
+ * projects one location at a time, over the whole coordinate range. It
+ * reports the throughput of both and the largest differences, and fails
+ * if the batched results are further than mercator_tolerance from the
+ * exact formula or further than osmium_tolerance from osmium.
+ *
+ * An optional argument takes only every Nth of the sample locations, so
+ * the accuracy check can run quickly as a test.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <osmium/geom/mercator_projection.hpp>
+#include <osmium/osm/location.hpp>
+
+#include "projection.hpp"
+
+// Largest difference in meters to osmium's results that is accepted. x is
+// computed the same way and must match. osmium computes y in double
+// precision, so it can be off from the exact formula by about as much as
+// mercator_project() is.
+constexpr double osmium_tolerance = 2 * mercator_tolerance;
+
+int main(int argc, char *argv[])
+{
+    const long long steps = 18000000;
+    const long long every = (argc > 1) ? std::atoll(argv[1]) : 1;
+    if (every <= 0 || steps % every != 0) {
+        std::cerr << "Usage: mercator_bench [N], N must divide " << steps
+                  << "\n";
+        return 2;
+    }
+
+    // Every 100th latitude and 200th longitude in osmium's fixed point
+    // format, from -90 to 90 and -180 to 180 degrees
+    const size_t count = static_cast<size_t>(steps / every) + 1;
+    std::vector<int32_t> x(count);
+    std::vector<int32_t> y(count);
+    for (size_t i = 0; i < count; ++i) {
+        x[i] = static_cast<int32_t>(-1800000000LL +
+                                    static_cast<long long>(i) * 200 * every);
+        y[i] = static_cast<int32_t>(-900000000LL +
+                                    static_cast<long long>(i) * 100 * every);
+    }
+
+    std::vector<double> batched(count * 2, 0.0);
+    std::vector<double> scalar(count * 2, 0.0);
+
+    auto start = std::chrono::steady_clock::now();
+    mercator_project(x.data(), y.data(), count, batched.data());
+    const std::chrono::duration<double> batched_time =
+        std::chrono::steady_clock::now() - start;
+
+    const osmium::geom::MercatorProjection projection;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        const osmium::geom::Coordinates c =
+            projection(osmium::Location{x[i], y[i]});
+        scalar[i * 2] = c.x;
+        scalar[i * 2 + 1] = c.y;
+    }
+    const std::chrono::duration<double> scalar_time =
+        std::chrono::steady_clock::now() - start;
+
+    double max_diff_osmium = 0;
+    double max_diff_exact = 0;
+    const long double pi = 3.141592653589793238462643383279502884L;
+    for (size_t i = 0; i < count; ++i) {
+        long double lat = y[i];
+        if (lat > mercator_max_lat_fixed) {
+            lat = mercator_max_lat_fixed;
+        } else if (lat < -mercator_max_lat_fixed) {
+            lat = -mercator_max_lat_fixed;
+        }
+        lat /= 10000000.0L;
+        const long double exact =
+            6378137.0L * std::log(std::tan(pi / 4 + lat * pi / 360));
+
+        max_diff_exact = std::max(
+            max_diff_exact,
+            static_cast<double>(std::fabs(batched[i * 2 + 1] - exact)));
+        // Only compare with osmium where it doesn't clamp differently
+        if (y[i] >= -mercator_max_lat_fixed &&
+            y[i] <= mercator_max_lat_fixed) {
+            max_diff_osmium =
+                std::max(max_diff_osmium,
+                         std::fabs(batched[i * 2 + 1] - scalar[i * 2 + 1]));
+        }
+        max_diff_osmium = std::max(max_diff_osmium,
+                                   std::fabs(batched[i * 2] - scalar[i * 2]));
+    }
+
+    std::cout << "batched: " << count / batched_time.count() / 1e6
+              << " M locations/s\n"
+              << "osmium:  " << count / scalar_time.count() / 1e6
+              << " M locations/s\n"
+              << "largest difference to osmium:        " << max_diff_osmium
+              << " m (tolerance " << osmium_tolerance << " m)\n"
+              << "largest difference to exact formula: " << max_diff_exact
+              << " m (tolerance " << mercator_tolerance << " m)\n";
+
+    return (max_diff_exact <= mercator_tolerance &&
+            max_diff_osmium <= osmium_tolerance)
+               ? 0
+               : 1;
+}
@@ -0,0 +1,99 @@
+#!/bin/sh
+#
+#  Runs osmborder_filter and osmborder on synthetic datasets of increasing
+#  size and prints the time and peak memory of every pass.
+#
+#  Usage: run_benchmark.sh GENERATOR OSMBORDER_FILTER OSMBORDER OUTDIR GRID...
+#
+#  Each GRID is passed to generate_boundaries as --grid, more options can
+#  be given in the GENERATE_OPTIONS environment variable. Results are
+#  collected in OUTDIR/results.csv.
+#
+#  If MAX_PASS_SECONDS or MAX_PEAK_MEMORY_MB are set, the script fails when
+#  any pass takes longer or uses more memory than that.
+#
+
+set -e
+
+if [ $# -lt 5 ]; then
+    echo "Usage: $0 GENERATOR OSMBORDER_FILTER OSMBORDER OUTDIR GRID..." >&2
+    exit 4
+fi
+
+generator=$1
+filter=$2
+osmborder=$3
+outdir=$4
+shift 4
+
+mkdir -p "$outdir"
+results="$outdir/results.csv"
+echo "grid,program,pass,wall_seconds,cpu_seconds,peak_memory_mb" >"$results"
+
+# osmborder_filter has no stats of its own, so GNU time measures it as a
+# whole if it is available.
+if /usr/bin/time -f "%e" true 2>/dev/null; then
+    have_time=yes
+else
+    have_time=no
+fi
+
+for grid in "$@"; do
+    input="$outdir/grid-$grid.osm.pbf"
+    filtered="$outdir/grid-$grid-filtered.osm.pbf"
+    stats="$outdir/grid-$grid-stats.json"
+
+    if [ ! -f "$input" ]; then
+        echo "Generating grid $grid..."
+        # shellcheck disable=SC2086
+        "$generator" --grid="$grid" $GENERATE_OPTIONS "$input"
+    fi
+
+    echo "Filtering grid $grid..."
+    if [ $have_time = yes ]; then
+        /usr/bin/time -f "%e %U %S %M" -o "$outdir/time.txt" \
+            "$filter" -o "$filtered" "$input"
+        awk -v grid="$grid" '{ printf "%s,osmborder_filter,all,%s,%.2f,%.1f\n",
+            grid, $1, $2 + $3, $4 / 1024 }' "$outdir/time.txt" >>"$results"
+        rm -f "$outdir/time.txt"
+    else
+        start=$(date +%s)
+        "$filter" -o "$filtered" "$input"
+        end=$(date +%s)
+        echo "$grid,osmborder_filter,all,$((end - start)),," >>"$results"
+    fi
+
+    echo "Running osmborder on grid $grid..."
+    "$osmborder" --overwrite --stats-file="$stats" \
+        -o "$outdir/grid-$grid-lines.csv" "$filtered"
+
+    # The stats file is written with one key per line, the passes are the
+    # objects with a name.
+    awk -v grid="$grid" '
+        /"name":/ { gsub(/[",]/, "", $2); name = $2 }
+        /"cpu_seconds":/ { gsub(/,/, "", $2); cpu = $2 }
+        /"peak_memory_mb":/ { gsub(/,/, "", $2); peak = $2 }
+        /"wall_seconds":/ && name != "" {
+            gsub(/,/, "", $2)
+            printf "%s,osmborder,%s,%s,%s,%s\n", grid, name, $2, cpu, peak
+            name = ""
+        }' "$stats" >>"$results"
+
+    rm -f "$filtered" "$outdir/grid-$grid-lines.csv"
+done
+
+column -s, -t "$results" 2>/dev/null || cat "$results"
+
+# Empty fields are unknown and never over budget
+awk -F, -v max_seconds="$MAX_PASS_SECONDS" -v max_memory="$MAX_PEAK_MEMORY_MB" '
+    NR > 1 && max_seconds != "" && $4 != "" && $4 + 0 > max_seconds + 0 {
+        printf "Over budget: %s pass %s on grid %s took %s s (max %s s)\n",
+            $2, $3, $1, $4, max_seconds
+        failed = 1
+    }
+    NR > 1 && max_memory != "" && $6 != "" && $6 + 0 > max_memory + 0 {
+        printf "Over budget: %s pass %s on grid %s used %s MB (max %s MB)\n",
+            $2, $3, $1, $6, max_memory
+        failed = 1
+    }
+    END { exit failed }' "$results" >&2
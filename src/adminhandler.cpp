@@ -0,0 +1,37 @@
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "adminhandler.hpp"
+
+// TODO: Cover all admin_levels
+// This is a map instead of something like an array of chars because admin_levels can extend past 9
+const std::map<std::string, const int> AdminHandler::admin_levels = {
+    {"2", 2}, {"3", 3}, {"4", 4},   {"5", 5},   {"6", 6},  {"7", 7},
+    {"8", 8}, {"9", 9}, {"10", 10}, {"11", 11}, {"12", 12}};
+
+const std::vector<TagRule> AdminHandler::way_tag_rules = {
+    {"disputed", "yes", way_flag_disputed},
+    {"dispute", "yes", way_flag_disputed},
+    {"border_status", "dispute", way_flag_disputed},
+    {"disputed_by", nullptr, way_flag_disputed},
+    {"maritime", "yes", way_flag_maritime},
+    {"natural", "coastline", way_flag_maritime},
+    {"boundary_type", "maritime", way_flag_maritime}};
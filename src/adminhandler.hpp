@@ -20,32 +20,300 @@
   along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
 
 */
-#include <osmium/geom/mercator_projection.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <osmium/handler.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+
+#include "ewkb.hpp"
+#include "linemerger.hpp"
+#include "hilbert.hpp"
+#include "idset.hpp"
+#include "lineoutput.hpp"
+#include "simplify.hpp"
+#include "trace.hpp"
+#include "tagclassifier.hpp"
 
 class AdminHandler : public osmium::handler::Handler
 {
+public:
+    // Node IDs seen in pass 2, used to skip the other nodes in pass 3
+    typedef IdSet NodeIdSet;
+
+    // Numbers of lines written and ways left out
+    struct LineCounts
+    {
+        // Lines by dividing_line + 2 * disputed + 4 * maritime
+        uint64_t lines_by_flags[8] = {};
+        uint64_t geometry_errors = 0;
+
+        void add(const LineCounts &other)
+        {
+            for (int i = 0; i < 8; ++i) {
+                lines_by_flags[i] += other.lines_by_flags[i];
+            }
+            geometry_errors += other.geometry_errors;
+        }
+    };
+
+    // Scratch space for building the geometries of a line, one per thread,
+    // and what the thread has written
+    struct GeometryBuilder
+    {
+        EWKBLineStringBuilder linestring;
+        LineSimplifier simplifier;
+        LineCounts counts;
+    };
+
 private:
     // p1
-    // All relations we are interested in will be kept in this buffer
-    osmium::memory::Buffer m_relations_buffer;
-    // Mapping of way IDs to the offset to the parent relation
-    typedef std::vector<size_t> RelationParents;
-    typedef std::map<osmium::unsigned_object_id_type, RelationParents>
-        WayRelations;
+    // The parts of the relations we are interested in. The full relations
+    // aren't kept, only what is needed to write the ways.
+    struct RelationInfo
+    {
+        osmium::object_id_type id;
+        // admin_level tag value, 0 if it is missing or not understood
+        int admin_level;
+    };
+    std::vector<RelationInfo> m_relations;
+    // Mapping of way IDs to the index of the parent relation. This is a
+    // flat vector of (way ID, index) pairs which is filled in pass 1 and
+    // sorted once before pass 2, so lookups are binary searches.
+    class WayRelations
+    {
+    public:
+        typedef std::pair<osmium::object_id_type, uint32_t> value_type;
+        typedef std::vector<value_type>::const_iterator const_iterator;
+
+        void add(osmium::object_id_type way_id, uint32_t rel_index)
+        {
+            m_links.emplace_back(way_id, rel_index);
+        }
+
+        void sort()
+        {
+            std::sort(m_links.begin(), m_links.end());
+            m_links.shrink_to_fit();
+        }
+
+        /// All links of a way. Only valid after sort().
+        std::pair<const_iterator, const_iterator>
+        find(osmium::object_id_type way_id) const
+        {
+            return std::equal_range(m_links.begin(), m_links.end(),
+                                    value_type(way_id, 0), compare_way);
+        }
+
+        bool contains(osmium::object_id_type way_id) const
+        {
+            return std::binary_search(m_links.begin(), m_links.end(),
+                                      value_type(way_id, 0), compare_way);
+        }
+
+        size_t size() const { return m_links.size(); }
+
+    private:
+        static bool compare_way(const value_type &a, const value_type &b)
+        {
+            return a.first < b.first;
+        }
+
+        std::vector<value_type> m_links;
+    };
     WayRelations m_way_rels;
 
     // p2
     // All ways we're interested in
     osmium::memory::Buffer m_ways_buffer;
+    // IDs of all nodes referenced by those ways
+    NodeIdSet m_node_ids;
+    // IDs of the nodes referenced more than once, which generalization
+    // keeps so the simplified ways still connect
+    NodeIdSet m_shared_node_ids;
+
+    // Every way is written to all outputs
+    const std::vector<LineOutput *> m_outputs;
+    // Does any output need the Hilbert key of the lines?
+    const bool m_need_sort_key;
+
+    GeometryBuilder m_geometry_builder;
+    // Lines of the current way for each output, used by way()
+    std::vector<std::string> m_lines;
+    // Totals of the counts of all geometry builders
+    LineCounts m_line_counts;
+    uint64_t m_relations_read = 0;
 
-    osmium::geom::WKBFactory<osmium::geom::MercatorProjection> m_factory{
-        osmium::geom::wkb_type::ewkb, osmium::geom::out_type::hex};
+    // Maximum number of points of merged lines, 0 if ways aren't merged
+    size_t m_merge_max_points = 0;
+    // The ways to merge and their attributes, in LineMerger line order
+    LineMerger m_merger;
+    std::vector<const osmium::Way *> m_merge_ways;
+    std::vector<LineAttributes> m_merge_attributes;
     static constexpr size_t initial_buffer_size = 1024 * 1024;
+    // Number of ways a thread converts in one go in build_linestrings()
+    static constexpr size_t ways_per_batch = 4096;
 
     static const std::map<std::string, const int> admin_levels;
+    // Tags on ways that make them disputed or maritime
+    static const std::vector<TagRule> way_tag_rules;
+    const TagClassifier m_way_classifier{way_tag_rules};
+    // Highest admin_level, so all levels fit in a 32 bit mask
+    static constexpr int max_admin_level = 31;
+
+public:
+    /**
+     * This handler operates on the ways-only pass and extracts way information, but can't
+     * yet do geometries since it doesn't have node information
+     */
+    class HandlerPass2 : public osmium::handler::Handler
+    {
+    public:
+        osmium::memory::Buffer &m_ways_buffer;
+        NodeIdSet &m_node_ids;
+        NodeIdSet &m_shared_node_ids;
+        const WayRelations &m_way_rels;
+        uint64_t m_ways_read = 0;
+        uint64_t m_ways_kept = 0;
+        // Only generalization needs the shared nodes, and the second
+        // bitmap spans the whole node ID range
+        bool m_collect_shared_nodes = false;
+
+        explicit HandlerPass2(osmium::memory::Buffer &ways_buffer,
+                              NodeIdSet &node_ids,
+                              NodeIdSet &shared_node_ids,
+                              const WayRelations &way_rels)
+        : m_ways_buffer(ways_buffer), m_node_ids(node_ids),
+          m_shared_node_ids(shared_node_ids), m_way_rels(way_rels)
+        {
+        }
+
+        void way(const osmium::Way &way)
+        {
+            ++m_ways_read;
+            if (m_way_rels.contains(way.id())) {
+                ++m_ways_kept;
+                m_ways_buffer.add_item(way);
+                m_ways_buffer.commit();
+                // Remember the nodes so pass 3 only stores their locations
+                if (!m_collect_shared_nodes) {
+                    for (const auto &nr : way.nodes()) {
+                        m_node_ids.set(nr.ref());
+                    }
+                    return;
+                }
+                for (const auto &nr : way.nodes()) {
+                    if (m_node_ids.get(nr.ref())) {
+                        m_shared_node_ids.set(nr.ref());
+                    } else {
+                        m_node_ids.set(nr.ref());
+                    }
+                }
+            }
+        }
+    };
+
+    explicit AdminHandler(const std::vector<LineOutput *> &outputs)
+    : m_ways_buffer(initial_buffer_size,
+                    osmium::memory::Buffer::auto_grow::yes),
+      m_outputs(outputs),
+      m_need_sort_key(std::any_of(
+          outputs.begin(), outputs.end(),
+          [](const LineOutput *output) { return output->needs_sort_key(); })),
+      m_lines(outputs.size()),
+      m_handler_pass2(m_ways_buffer, m_node_ids, m_shared_node_ids,
+                      m_way_rels)
+    {
+    }
+
+    /// Writes anything the output formats need before the first line
+    void write_header()
+    {
+        for (LineOutput *output : m_outputs) {
+            output->write_header();
+        }
+    }
+
+    /// Writes anything the output formats need after the last line
+    void write_trailer()
+    {
+        for (LineOutput *output : m_outputs) {
+            output->write_trailer();
+        }
+    }
+
+    /* This is where the logic that handles tagging lives, getting tags from the way and parent rels */
+    void way(const osmium::Way &way)
+    {
+        std::string errors;
+        for (auto &lines : m_lines) {
+            lines.clear();
+        }
+        write_way(way, m_geometry_builder, m_lines, errors);
+        m_line_counts.add(m_geometry_builder.counts);
+        m_geometry_builder.counts = LineCounts{};
+        for (size_t i = 0; i < m_outputs.size(); ++i) {
+            m_outputs[i]->write(m_lines[i]);
+        }
+        std::cerr << errors;
+    }
+
+    /**
+     * Works out the output attributes of a way from its tags and the tags
+     * of its parent relations. Returns false if no parent has a usable
+     * admin_level, in which case the way isn't written.
+     */
+    bool way_attributes(const osmium::Way &way,
+                        LineAttributes &attributes) const
+    {
+        // One bit per admin_level seen on a parent relation, and one bit per
+        // admin_level seen on more than one of them
+        uint32_t parent_admin_levels = 0;
+        uint32_t shared_admin_levels = 0;
+
+        // Tags on the parent relations
+        const auto rels = m_way_rels.find(way.id());
+        for (auto rel_it = rels.first; rel_it != rels.second; ++rel_it) {
+            const int admin_level = m_relations[rel_it->second].admin_level;
+            if (admin_level > 0 && admin_level <= max_admin_level) {
+                const uint32_t bit = 1u << admin_level;
+                shared_admin_levels |= parent_admin_levels & bit;
+                parent_admin_levels |= bit;
+            }
+        }
+
+        if (parent_admin_levels == 0) {
+            return false;
+        }
+
+        int min_parent_admin_level = 1;
+        while (!(parent_admin_levels & (1u << min_parent_admin_level))) {
+            ++min_parent_admin_level;
+        }
+
+        // Tags on the way itself
+        const unsigned flags = m_way_classifier.classify(way.tags());
+
+        attributes.admin_level = min_parent_admin_level;
+        // Checks if two parents are the same admin level
+        attributes.dividing_line = shared_admin_levels != 0;
+        attributes.disputed = flags & way_flag_disputed;
+        attributes.maritime = flags & way_flag_maritime;
+        return true;
+    }
 
     // Based on osm2pgsql escaping
-    std::string escape(const std::string &src)
+    static std::string escape(const std::string &src)
     {
         std::string dst;
         for (const char c : src) {
@@ -73,119 +341,349 @@ private:
         return dst;
     }
 
-    std::ostream &m_out;
+    static void append_geometry_error(std::string &errors,
+                                      const osmium::Way &way,
+                                      const osmium::geometry_error &e)
+    {
+        errors.append("Geometry error on way ");
+        errors.append(std::to_string(way.id()));
+        errors.append(": ");
+        errors.append(e.what());
+        errors.push_back('\n');
+    }
 
-public:
     /**
-     * This handler operates on the ways-only pass and extracts way information, but can't
-     * yet do geometries since it doesn't have node information
+     * Appends the output lines for a way to lines, which has one string
+     * per output. Geometry errors are appended to errors instead. This
+     * only reads the handler state, so several threads can call it at
+     * once as long as each one brings its own geometry builder.
      */
-    class HandlerPass2 : public osmium::handler::Handler
+    void write_way(const osmium::Way &way, GeometryBuilder &builder,
+                   std::vector<std::string> &lines,
+                   std::string &errors) const
     {
-    public:
-        osmium::memory::Buffer &m_ways_buffer;
-        const WayRelations &m_way_rels;
-
-        explicit HandlerPass2(osmium::memory::Buffer &ways_buffer,
-                              const WayRelations &way_rels)
-        : m_ways_buffer(ways_buffer), m_way_rels(way_rels)
-        {
+        LineAttributes attributes;
+        if (!way_attributes(way, attributes)) {
+            return;
         }
 
-        void way(const osmium::Way &way)
-        {
-            if (m_way_rels.count(way.id()) > 0) {
-                m_ways_buffer.add_item(way);
-            }
+        try {
+            // Convert here to ensure errors don't result in partial output lines.
+            builder.linestring.set_nodes(way.nodes());
+            append_lines(way.id(), attributes, builder, lines);
+        } catch (osmium::geometry_error &e) {
+            ++builder.counts.geometry_errors;
+            append_geometry_error(errors, way, e);
         }
-    };
+    }
 
-    AdminHandler(std::ostream &out)
-    : m_ways_buffer(initial_buffer_size,
-                    osmium::memory::Buffer::auto_grow::yes),
-      m_relations_buffer(initial_buffer_size,
-                         osmium::memory::Buffer::auto_grow::yes),
-      m_handler_pass2(m_ways_buffer, m_way_rels), m_out(out)
+    /**
+     * Appends the output lines for merged line n, like write_way(). The
+     * ways were checked by merge_ways(), so there are no geometry errors.
+     */
+    void write_merged_line(size_t n, GeometryBuilder &builder,
+                           std::vector<std::string> &lines) const
     {
+        std::vector<osmium::object_id_type> way_ids;
+        builder.linestring.clear();
+        for (auto part = m_merger.parts_begin(n); part != m_merger.parts_end(n);
+             ++part) {
+            const osmium::Way &way = *m_merge_ways[part->line];
+            way_ids.push_back(way.id());
+            builder.linestring.add_nodes(way.nodes(), part->reversed);
+        }
+
+        const LineAttributes &attributes =
+            m_merge_attributes[m_merger.parts_begin(n)->line];
+        append_lines(way_ids, attributes, builder, lines);
     }
 
-    /* This is where the logic that handles tagging lives, getting tags from the way and parent rels */
-    void way(const osmium::Way &way)
+    static osmium::object_id_type first_id(osmium::object_id_type id)
     {
-        std::vector<int> parent_admin_levels;
-        bool disputed = false;
-        bool maritime = false;
+        return id;
+    }
 
-        // Tags on the way itself
-        disputed = disputed || way.tags().has_tag("disputed", "yes");
-        disputed = disputed || way.tags().has_tag("dispute", "yes");
-        disputed = disputed || way.tags().has_tag("border_status", "dispute");
-        disputed = disputed || way.tags().has_key("disputed_by");
+    static osmium::object_id_type
+    first_id(const std::vector<osmium::object_id_type> &way_ids)
+    {
+        return way_ids.front();
+    }
 
-        maritime = maritime || way.tags().has_tag("maritime", "yes");
-        maritime = maritime || way.tags().has_tag("natural", "coastline");
-        maritime = maritime || way.tags().has_tag("boundary_type", "maritime");
+    /**
+     * Appends the lines for the points in the linestring builder to all
+     * outputs. TId is a way ID or the list of IDs of a merged line.
+     */
+    template <typename TId>
+    void append_lines(const TId &id, const LineAttributes &attributes,
+                      GeometryBuilder &builder,
+                      std::vector<std::string> &lines) const
+    {
+        // Generalized lines use the same key, so all outputs have the
+        // same order
+        const uint64_t sort_key =
+            m_need_sort_key
+                ? bbox_hilbert_key(builder.linestring.x(),
+                                   builder.linestring.y(),
+                                   builder.linestring.size())
+                : 0;
+        ++builder.counts.lines_by_flags[attributes.dividing_line +
+                                        2 * attributes.disputed +
+                                        4 * attributes.maritime];
+        bool simplifier_ready = false;
+        for (size_t i = 0; i < m_outputs.size(); ++i) {
+            const LineOutput &output = *m_outputs[i];
+            if (!output.accepts(first_id(id), sort_key)) {
+                continue;
+            }
+            if (output.tolerance() <= 0) {
+                output.append_line(
+                    lines[i], id, attributes,
+                    builder.linestring.linestring(output.projection()),
+                    sort_key);
+                continue;
+            }
 
-        // Tags on the parent relations
-        for (const auto &rel_offset : m_way_rels[way.id()]) {
-            const osmium::TagList &tags =
-                m_relations_buffer.get<const osmium::Relation>(rel_offset)
-                    .tags();
-            const char *admin_level = tags.get_value_by_key("admin_level", "");
-            /* can't use admin_levels[] because [] is non-const, but there must be a better way? */
-            auto admin_it = admin_levels.find(admin_level);
-            if (admin_it != admin_levels.end()) {
-                parent_admin_levels.push_back(admin_it->second);
+            if (!simplifier_ready) {
+                const EWKBLineStringBuilder &linestring = builder.linestring;
+                builder.simplifier.set_points(linestring.x(), linestring.y(),
+                                              linestring.size());
+                const auto &node_ids = linestring.node_ids();
+                for (size_t point = 0; point < node_ids.size(); ++point) {
+                    if (m_shared_node_ids.get(node_ids[point])) {
+                        builder.simplifier.fix(point);
+                    }
+                }
+                simplifier_ready = true;
             }
+            output.append_line(
+                lines[i], id, attributes,
+                builder.linestring.linestring(
+                    output.projection(),
+                    builder.simplifier.simplify(output.tolerance())),
+                sort_key);
         }
+    }
 
-        if (parent_admin_levels.size() > 0) {
+    /**
+     * Joins the ways with the same attributes into longer lines, see
+     * LineMerger. Ways with geometry errors are reported and left out.
+     */
+    void merge_ways(const std::vector<const osmium::Way *> &ways)
+    {
+        TraceSpan span{"merge ways", "geometry"};
+        EWKBLineStringBuilder linestring_builder;
+        for (const osmium::Way *way_ptr : ways) {
+            LineAttributes attributes;
+            if (!way_attributes(*way_ptr, attributes)) {
+                continue;
+            }
             try {
-                // Sort for both min parent admin level and if it divides areas
-                std::sort(parent_admin_levels.begin(),
-                          parent_admin_levels.end());
-                const int min_parent_admin_level = parent_admin_levels[0];
-
-                // Checks if two parents are the same admin level
-                const bool dividing_line =
-                    std::adjacent_find(parent_admin_levels.begin(),
-                                       parent_admin_levels.end()) !=
-                    parent_admin_levels.end();
-
-                // Convert here to ensure errors don't result in partial output lines.
-                const std::string linestring = m_factory.create_linestring(way);
-
-                m_out << way.id() << "\t"
-                      // parent_admin_levels is already escaped.
-                      << min_parent_admin_level << "\t"
-                      << ((dividing_line) ? ("true") : ("false")) << "\t"
-                      << ((disputed) ? ("true") : ("false")) << "\t"
-                      << ((maritime) ? ("true") : ("false")) << "\t"
-                      << linestring << "\n";
+                linestring_builder.set_nodes(way_ptr->nodes());
             } catch (osmium::geometry_error &e) {
-                std::cerr << "Geometry error on way " << way.id() << ": "
-                          << e.what() << "\n";
+                ++m_line_counts.geometry_errors;
+                std::string errors;
+                append_geometry_error(errors, *way_ptr, e);
+                std::cerr << errors;
+                continue;
             }
+            const uint64_t key =
+                static_cast<uint64_t>(attributes.admin_level) << 3 |
+                attributes.dividing_line << 2 | attributes.disputed << 1 |
+                attributes.maritime;
+            m_merger.add(key, location_key(way_ptr->nodes().front()),
+                         location_key(way_ptr->nodes().back()),
+                         linestring_builder.size());
+            m_merge_ways.push_back(way_ptr);
+            m_merge_attributes.push_back(attributes);
         }
+        m_merger.merge(m_merge_max_points);
+    }
+
+    static uint64_t location_key(const osmium::NodeRef &node_ref)
+    {
+        return static_cast<uint64_t>(
+                   static_cast<uint32_t>(node_ref.location().x()))
+                   << 32 |
+               static_cast<uint32_t>(node_ref.location().y());
     }
 
+    /**
+     * Calls write_item(i, builder, lines, errors) for all items
+     * below count, split into batches which are converted by num_threads
+     * threads. The batches are always written in order so the output
+     * doesn't depend on the number of threads.
+     */
+    template <typename TWriteItem>
+    void run_batches(size_t count, unsigned int num_threads,
+                     TWriteItem write_item)
+    {
+        // Each round converts a few batches per thread before writing them.
+        // Every batch has one string of lines per output.
+        const size_t batches_per_round = num_threads * 4;
+        std::vector<std::vector<std::string>> lines(
+            batches_per_round, std::vector<std::string>(m_outputs.size()));
+        std::vector<std::string> errors(batches_per_round);
+        std::mutex counts_mutex;
+
+        for (size_t round_start = 0; round_start < count;
+             round_start += batches_per_round * ways_per_batch) {
+            const size_t num_batches = std::min(
+                batches_per_round,
+                (count - round_start + ways_per_batch - 1) / ways_per_batch);
+            std::atomic<size_t> next_batch{0};
+
+            auto worker = [&]() {
+                GeometryBuilder builder;
+                for (size_t batch = next_batch++; batch < num_batches;
+                     batch = next_batch++) {
+                    TraceSpan span{"batch", "geometry"};
+                    const size_t first =
+                        round_start + batch * ways_per_batch;
+                    const size_t last =
+                        std::min(count, first + ways_per_batch);
+                    for (auto &output_lines : lines[batch]) {
+                        output_lines.clear();
+                    }
+                    errors[batch].clear();
+                    for (size_t i = first; i < last; ++i) {
+                        write_item(i, builder, lines[batch], errors[batch]);
+                    }
+                }
+                std::lock_guard<std::mutex> lock{counts_mutex};
+                m_line_counts.add(builder.counts);
+            };
+
+            if (num_threads <= 1) {
+                worker();
+            } else {
+                std::vector<std::thread> threads;
+                for (unsigned int i = 0; i < num_threads; ++i) {
+                    threads.emplace_back(worker);
+                }
+                for (auto &thread : threads) {
+                    thread.join();
+                }
+            }
+
+            TraceSpan span{"write batches", "output"};
+            for (size_t batch = 0; batch < num_batches; ++batch) {
+                for (size_t i = 0; i < m_outputs.size(); ++i) {
+                    m_outputs[i]->write(lines[batch][i]);
+                }
+                std::cerr << errors[batch];
+            }
+        }
+    }
+
+    /**
+     * Writes the lines for all buffered ways. The node locations must
+     * already be set on the ways. With merging enabled the ways are
+     * joined first and each merged line is written instead.
+     */
+    void build_linestrings(unsigned int num_threads)
+    {
+        std::vector<const osmium::Way *> ways;
+        for (auto it = m_ways_buffer.begin<osmium::Way>();
+             it != m_ways_buffer.end<osmium::Way>(); ++it) {
+            ways.push_back(&*it);
+        }
+
+        if (m_merge_max_points > 0) {
+            merge_ways(ways);
+            run_batches(m_merger.size(), num_threads,
+                        [this](size_t n, GeometryBuilder &builder,
+                               std::vector<std::string> &lines,
+                               std::string &) {
+                            write_merged_line(n, builder, lines);
+                        });
+            return;
+        }
+
+        run_batches(ways.size(), num_threads,
+                    [this, &ways](size_t i, GeometryBuilder &builder,
+                                  std::vector<std::string> &lines,
+                                  std::string &errors) {
+                        write_way(*ways[i], builder, lines, errors);
+                    });
+    }
+
+    /**
+     * Joins ways into lines of at most max_points points before writing
+     * them, and adds the IDs of the joined ways as an extra column.
+     */
+    void enable_merge(size_t max_points) { m_merge_max_points = max_points; }
+
+    /**
+     * Remembers the nodes shared by several ways in pass 2, so simplified
+     * lines keep them. Call this before pass 2 if any output has a
+     * simplification tolerance.
+     */
+    void enable_shared_nodes()
+    {
+        m_handler_pass2.m_collect_shared_nodes = true;
+    }
+
+    /// Number of lines written by build_linestrings() with merging enabled
+    size_t merged_lines_count() const { return m_merger.size(); }
+
     void relation(const osmium::Relation &relation)
     {
+        ++m_relations_read;
         if (relation.tags().has_tag("boundary", "administrative")) {
-            m_relations_buffer.add_item(relation);
-            auto relation_offset = m_relations_buffer.commit();
+            const char *admin_level =
+                relation.tags().get_value_by_key("admin_level", "");
+            /* can't use admin_levels[] because [] is non-const, but there must be a better way? */
+            auto admin_it = admin_levels.find(admin_level);
+
+            const uint32_t relation_index =
+                static_cast<uint32_t>(m_relations.size());
+            m_relations.push_back(
+                {relation.id(),
+                 (admin_it != admin_levels.end()) ? admin_it->second : 0});
             for (const auto &rm : relation.members()) {
                 if (rm.type() == osmium::item_type::way) {
-                    // Calls the default constructor if it doesn't exist, otherwise add to the back
-                    // TODO: Can this call the constructor to create a vector of size N, where N=2?
-                    m_way_rels[rm.ref()].push_back(relation_offset);
+                    m_way_rels.add(rm.ref(), relation_index);
+                }
+            }
+        }
+    }
+
+    /// Prepares the way relation links for lookups. Call this after pass 1.
+    void sort_way_relations() { m_way_rels.sort(); }
+
+    size_t relations_count() const { return m_relations.size(); }
+
+    uint64_t relations_read() const { return m_relations_read; }
+
+    uint64_t ways_read() const { return m_handler_pass2.m_ways_read; }
+
+    /// Number of ways kept in pass 2
+    uint64_t ways_count() const { return m_handler_pass2.m_ways_kept; }
+
+    /// What build_linestrings() has written
+    const LineCounts &line_counts() const { return m_line_counts; }
+
+    /// Number of node references on the kept ways without a location
+    uint64_t missing_locations() const
+    {
+        uint64_t missing = 0;
+        for (auto it = m_ways_buffer.cbegin<osmium::Way>();
+             it != m_ways_buffer.cend<osmium::Way>(); ++it) {
+            for (const auto &node_ref : it->nodes()) {
+                if (!node_ref.location().valid()) {
+                    ++missing;
                 }
             }
         }
+        return missing;
     }
 
+    size_t way_relations_count() const { return m_way_rels.size(); }
+
     osmium::memory::Buffer &get_ways() { return m_ways_buffer; }
 
+    const NodeIdSet &get_node_ids() const { return m_node_ids; }
+
     void flush() {}
     // Handler for the pass2 ways
     HandlerPass2 m_handler_pass2;
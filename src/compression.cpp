@@ -0,0 +1,122 @@
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <system_error>
+
+#include <zlib.h>
+#ifdef OSMBORDER_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "compression.hpp"
+
+namespace {
+
+#ifdef OSMBORDER_WITH_ZSTD
+constexpr bool zstd_available = true;
+#else
+constexpr bool zstd_available = false;
+#endif
+
+bool ends_with(const std::string &text, const char *suffix, size_t size)
+{
+    return text.size() > size &&
+           text.compare(text.size() - size, size, suffix) == 0;
+}
+
+[[noreturn]] void compression_failed(const char *library)
+{
+    throw std::system_error{std::make_error_code(std::errc::io_error),
+                            std::string{library} + " compression failed"};
+}
+
+std::string compress_gzip(const std::string &data)
+{
+    z_stream stream{};
+    // 16 more window bits for a gzip header instead of a zlib one
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        compression_failed("gzip");
+    }
+
+    std::string out;
+    out.resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+    stream.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+
+    const int result = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        compression_failed("gzip");
+    }
+    return out;
+}
+
+#ifdef OSMBORDER_WITH_ZSTD
+std::string compress_zstd(const std::string &data)
+{
+    std::string out;
+    out.resize(ZSTD_compressBound(data.size()));
+    const size_t size =
+        ZSTD_compress(&out[0], out.size(), data.data(), data.size(), 3);
+    if (ZSTD_isError(size)) {
+        compression_failed("zstd");
+    }
+    out.resize(size);
+    return out;
+}
+#endif
+
+} // anonymous namespace
+
+compression compression_from_filename(const std::string &filename)
+{
+    if (ends_with(filename, ".gz", 3)) {
+        return compression::gzip;
+    }
+    if (ends_with(filename, ".zst", 4)) {
+        return compression::zstd;
+    }
+    return compression::none;
+}
+
+bool compression_available(compression type)
+{
+    return type != compression::zstd || zstd_available;
+}
+
+std::string compress_frame(compression type, const std::string &data)
+{
+    switch (type) {
+    case compression::gzip:
+        return compress_gzip(data);
+#ifdef OSMBORDER_WITH_ZSTD
+    case compression::zstd:
+        return compress_zstd(data);
+#endif
+    default:
+        return data;
+    }
+}
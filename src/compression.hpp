@@ -0,0 +1,51 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <string>
+
+/// Compression of output files, chosen by the file name
+enum class compression
+{
+    none,
+    /// .gz, concatenated gzip members
+    gzip,
+    /// .zst, concatenated zstd frames, only if built with zstd
+    zstd
+};
+
+/// The compression for a file name ending in .gz or .zst
+compression compression_from_filename(const std::string &filename);
+
+/// Can files be written with this compression? zstd is optional.
+bool compression_available(compression type);
+
+/**
+ * Compresses data into one self-contained gzip member or zstd frame.
+ * Frames can be concatenated and decompressed as one stream, so they can
+ * be compressed independently on different threads. Errors are reported
+ * as std::system_error.
+ */
+std::string compress_frame(compression type, const std::string &data);
+
+#endif // COMPRESSION_HPP
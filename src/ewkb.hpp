@@ -0,0 +1,186 @@
+#ifndef EWKB_HPP
+#define EWKB_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <osmium/geom/factory.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/osm/way.hpp>
+
+/**
+ * Builds EWKB linestrings from way node lists, in the same layout as
+ * osmium's WKBFactory with wkb_type::ewkb. The geometry is built in
+ * buffers that are reused from way to way, so there is no allocation per
+ * geometry once the buffers are large enough.
+ *
+ * The node locations are collected once with set_nodes() and can then be
+ * written in several projections, see BatchProjection.
+ */
+class EWKBLineStringBuilder
+{
+    // EWKB type of a linestring with the SRID flag set
+    static constexpr uint32_t ewkb_linestring = 0x20000002;
+
+    std::string m_data;
+    // Fixed point coordinates of the unique locations and their projection
+    std::vector<int32_t> m_x;
+    std::vector<int32_t> m_y;
+    std::vector<double> m_coordinates;
+    // IDs of the nodes the points come from
+    std::vector<osmium::object_id_type> m_node_ids;
+    // Points picked by linestring() with a list of points
+    std::vector<int32_t> m_subset_x;
+    std::vector<int32_t> m_subset_y;
+
+    template <typename T>
+    void append(T value)
+    {
+        const size_t start = m_data.size();
+        m_data.resize(start + sizeof(T));
+        std::memcpy(&m_data[start], &value, sizeof(T));
+    }
+
+    static uint8_t byte_order()
+    {
+        // Values are written in host byte order, so the flag must match it
+        const uint16_t one = 1;
+        uint8_t first;
+        std::memcpy(&first, &one, 1);
+        return first; // 1 is little endian (NDR), 0 is big endian (XDR)
+    }
+
+public:
+    /**
+     * Collects the locations of the nodes. Consecutive duplicate
+     * locations are skipped. Throws osmium::geometry_error if fewer than
+     * two points remain or a location is invalid.
+     */
+    void set_nodes(const osmium::WayNodeList &nodes)
+    {
+        clear();
+        add_nodes(nodes);
+        if (m_x.size() < 2) {
+            throw osmium::geometry_error{
+                "need at least two points for linestring"};
+        }
+    }
+
+    void clear()
+    {
+        m_x.clear();
+        m_y.clear();
+        m_node_ids.clear();
+    }
+
+    /**
+     * Appends the locations of the nodes, from the last to the first one
+     * if reverse is set. Locations equal to the previous one are skipped,
+     * including the first one if the nodes continue the line. Throws
+     * osmium::geometry_error if a location is invalid.
+     */
+    void add_nodes(const osmium::WayNodeList &nodes, bool reverse = false)
+    {
+        const size_t count = nodes.size();
+        for (size_t i = 0; i < count; ++i) {
+            const osmium::Location location =
+                nodes[reverse ? count - 1 - i : i].location();
+            if (!m_x.empty() && location.x() == m_x.back() &&
+                location.y() == m_y.back()) {
+                continue;
+            }
+            if (!location.valid()) {
+                throw osmium::geometry_error{"invalid location"};
+            }
+            m_x.push_back(location.x());
+            m_y.push_back(location.y());
+            m_node_ids.push_back(nodes[reverse ? count - 1 - i : i].ref());
+        }
+    }
+
+    /// Number of points collected by set_nodes()
+    size_t size() const { return m_x.size(); }
+
+    /// Fixed point coordinates of the collected points
+    const int32_t *x() const { return m_x.data(); }
+    const int32_t *y() const { return m_y.data(); }
+
+    /// Node IDs of the collected points
+    const std::vector<osmium::object_id_type> &node_ids() const
+    {
+        return m_node_ids;
+    }
+
+    /**
+     * Returns the EWKB bytes of the collected points in the given
+     * projection. The result is valid until the next call.
+     */
+    template <typename TProjection>
+    const std::string &linestring(const TProjection &projection)
+    {
+        return write(projection, m_x.data(), m_y.data(), m_x.size());
+    }
+
+    /**
+     * Like linestring(projection), but only with the points at the given
+     * indices, e.g. from LineSimplifier.
+     */
+    template <typename TProjection>
+    const std::string &linestring(const TProjection &projection,
+                                  const std::vector<uint32_t> &points)
+    {
+        m_subset_x.clear();
+        m_subset_y.clear();
+        for (const uint32_t point : points) {
+            m_subset_x.push_back(m_x[point]);
+            m_subset_y.push_back(m_y[point]);
+        }
+        return write(projection, m_subset_x.data(), m_subset_y.data(),
+                     points.size());
+    }
+
+private:
+    template <typename TProjection>
+    const std::string &write(const TProjection &projection, const int32_t *x,
+                             const int32_t *y, size_t num_points)
+    {
+        m_coordinates.resize(num_points * 2);
+        projection(x, y, num_points, m_coordinates.data());
+
+        m_data.clear();
+        append<uint8_t>(byte_order());
+        append<uint32_t>(ewkb_linestring);
+        append<uint32_t>(static_cast<uint32_t>(projection.epsg()));
+        append<uint32_t>(static_cast<uint32_t>(num_points));
+        m_data.append(reinterpret_cast<const char *>(m_coordinates.data()),
+                      m_coordinates.size() * sizeof(double));
+
+        return m_data;
+    }
+};
+
+#endif // EWKB_HPP
@@ -0,0 +1,51 @@
+#ifndef HEX_HPP
+#define HEX_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstddef>
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                             \
+    (defined(__x86_64__) || defined(__i386__))
+#define OSMBORDER_HEX_X86
+#endif
+
+/**
+ * Writes size bytes from data to out as upper case hex, 2 * size
+ * characters. The kernel is picked on the first call, SSE2 if the CPU
+ * supports it.
+ */
+void hex_encode(const char *data, size_t size, char *out);
+
+/// Name of the kernel hex_encode() uses, for --verbose and benchmarks
+const char *hex_encode_kernel();
+
+/// The individual kernels, only called directly by benchmarks
+void hex_encode_scalar(const char *data, size_t size, char *out);
+#ifdef OSMBORDER_HEX_X86
+bool hex_encode_has_sse2();
+bool hex_encode_has_avx2();
+void hex_encode_sse2(const char *data, size_t size, char *out);
+void hex_encode_avx2(const char *data, size_t size, char *out);
+#endif
+
+#endif // HEX_HPP
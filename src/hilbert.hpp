@@ -0,0 +1,84 @@
+#ifndef HILBERT_HPP
+#define HILBERT_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Position of a location on a Hilbert curve through a 2^32 x 2^32 grid
+ * over the whole lon/lat range. Locations close on the curve are close
+ * on the map, so rows sorted by this key are spatially clustered.
+ * The location is in osmium's fixed point format.
+ */
+inline uint64_t hilbert_key(int32_t x, int32_t y)
+{
+    // Scale to 0 .. 2^32-1
+    const uint64_t cells = uint64_t(1) << 32;
+    uint32_t hx = static_cast<uint32_t>(
+        (static_cast<uint64_t>(static_cast<int64_t>(x) + 1800000000) *
+         cells) /
+        3600000001ull);
+    uint32_t hy = static_cast<uint32_t>(
+        (static_cast<uint64_t>(static_cast<int64_t>(y) + 900000000) * cells) /
+        1800000001ull);
+
+    uint64_t key = 0;
+    for (uint32_t s = uint32_t(1) << 31; s > 0; s >>= 1) {
+        const uint32_t rx = (hx & s) ? 1 : 0;
+        const uint32_t ry = (hy & s) ? 1 : 0;
+        key += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve stays continuous
+        if (ry == 0) {
+            if (rx == 1) {
+                hx = ~hx;
+                hy = ~hy;
+            }
+            const uint32_t t = hx;
+            hx = hy;
+            hy = t;
+        }
+    }
+    return key;
+}
+
+/// hilbert_key() of the center of the bounding box of count points
+inline uint64_t bbox_hilbert_key(const int32_t *x, const int32_t *y,
+                                 size_t count)
+{
+    int32_t min_x = x[0];
+    int32_t max_x = x[0];
+    int32_t min_y = y[0];
+    int32_t max_y = y[0];
+    for (size_t i = 1; i < count; ++i) {
+        min_x = x[i] < min_x ? x[i] : min_x;
+        max_x = x[i] > max_x ? x[i] : max_x;
+        min_y = y[i] < min_y ? y[i] : min_y;
+        max_y = y[i] > max_y ? y[i] : max_y;
+    }
+    return hilbert_key(
+        static_cast<int32_t>((static_cast<int64_t>(min_x) + max_x) / 2),
+        static_cast<int32_t>((static_cast<int64_t>(min_y) + max_y) / 2));
+}
+
+#endif // HILBERT_HPP
@@ -0,0 +1,70 @@
+#ifndef IDSET_HPP
+#define IDSET_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstddef>
+
+#include <osmium/index/id_set.hpp>
+#include <osmium/osm/types.hpp>
+
+/**
+ * Set of object IDs, dense bitmaps so membership checks are cheap.
+ * Negative IDs get their own bitmap so they don't clash with positive ones.
+ *
+ * The bitmaps are allocated in chunks covering a fixed range of IDs, so
+ * memory grows with the largest ID in the set, not with the number of
+ * IDs. Boundary nodes are spread over the whole ID range of a planet, so
+ * nearly every chunk is used and one set takes about one bit per node ID,
+ * some 1.5 GB at current planet IDs. A sorted vector of the boundary
+ * node refs would take about as much before deduplication, and would need
+ * a sort after pass 2.
+ */
+class IdSet
+{
+    osmium::index::IdSetDense<osmium::unsigned_object_id_type> m_positive;
+    osmium::index::IdSetDense<osmium::unsigned_object_id_type> m_negative;
+
+public:
+    void set(osmium::object_id_type id)
+    {
+        if (id >= 0) {
+            m_positive.set(static_cast<osmium::unsigned_object_id_type>(id));
+        } else {
+            m_negative.set(static_cast<osmium::unsigned_object_id_type>(-id));
+        }
+    }
+
+    bool get(osmium::object_id_type id) const
+    {
+        if (id >= 0) {
+            return m_positive.get(
+                static_cast<osmium::unsigned_object_id_type>(id));
+        }
+        return m_negative.get(
+            static_cast<osmium::unsigned_object_id_type>(-id));
+    }
+
+    size_t size() const { return m_positive.size() + m_negative.size(); }
+};
+
+#endif // IDSET_HPP
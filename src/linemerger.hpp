@@ -0,0 +1,175 @@
+#ifndef LINEMERGER_HPP
+#define LINEMERGER_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Joins lines that share an endpoint into longer lines. Only lines with
+ * the same key are joined, and only where exactly two ends of lines with
+ * that key meet, so junctions stay line ends. Lines are never split, so a
+ * single line can be longer than the maximum number of points.
+ *
+ * Lines are identified by the order in which they are added. The result
+ * is a list of parts for each merged line.
+ */
+class LineMerger
+{
+public:
+    /// One input line in a merged line
+    struct Part
+    {
+        size_t line;
+        // The line is walked from its last point to its first
+        bool reversed;
+    };
+
+    /**
+     * Adds a line. first and last identify its end points, e.g. packed
+     * locations, and num_points is its number of points.
+     */
+    void add(uint64_t key, uint64_t first, uint64_t last, size_t num_points)
+    {
+        const size_t line = m_num_points.size();
+        m_ends.push_back({key, first, line * 2});
+        m_ends.push_back({key, last, line * 2 + 1});
+        m_num_points.push_back(num_points);
+    }
+
+    /**
+     * Merges the lines. Joined lines share a point, so a merged line has
+     * one point less than its parts for every join. A line is only
+     * appended while the result has at most max_points points.
+     */
+    void merge(size_t max_points)
+    {
+        const size_t num_lines = m_num_points.size();
+
+        // The end joined to each line end, or no_end. Ends meeting at a
+        // point are next to each other after sorting.
+        std::sort(m_ends.begin(), m_ends.end());
+        std::vector<size_t> joined(num_lines * 2, size_t{no_end});
+        for (size_t i = 0; i < m_ends.size();) {
+            size_t j = i + 1;
+            while (j < m_ends.size() && m_ends[j].key == m_ends[i].key &&
+                   m_ends[j].point == m_ends[i].point) {
+                ++j;
+            }
+            // A closed line meeting itself isn't joined either
+            if (j - i == 2 && m_ends[i].end / 2 != m_ends[i + 1].end / 2) {
+                joined[m_ends[i].end] = m_ends[i + 1].end;
+                joined[m_ends[i + 1].end] = m_ends[i].end;
+            }
+            i = j;
+        }
+        m_ends.clear();
+        m_ends.shrink_to_fit();
+
+        std::vector<bool> done(num_lines, false);
+        // Start at free ends first, then break up the remaining rings
+        for (int pass = 0; pass < 2; ++pass) {
+            for (size_t line = 0; line < num_lines; ++line) {
+                if (done[line]) {
+                    continue;
+                }
+                size_t start = line * 2;
+                if (pass == 0) {
+                    if (joined[start] != no_end) {
+                        ++start;
+                        if (joined[start] != no_end) {
+                            continue;
+                        }
+                    }
+                }
+                walk(start, joined, done, max_points);
+            }
+        }
+    }
+
+    /// Number of merged lines
+    size_t size() const { return m_line_starts.size(); }
+
+    /// The parts of merged line n
+    const Part *parts_begin(size_t n) const
+    {
+        return m_parts.data() + m_line_starts[n];
+    }
+
+    const Part *parts_end(size_t n) const
+    {
+        return m_parts.data() +
+               (n + 1 < m_line_starts.size() ? m_line_starts[n + 1]
+                                             : m_parts.size());
+    }
+
+private:
+    static constexpr size_t no_end = static_cast<size_t>(-1);
+
+    struct End
+    {
+        uint64_t key;
+        uint64_t point;
+        // Line index * 2, plus 1 for the last point
+        size_t end;
+
+        bool operator<(const End &other) const
+        {
+            return key < other.key ||
+                   (key == other.key &&
+                    (point < other.point ||
+                     (point == other.point && end < other.end)));
+        }
+    };
+
+    std::vector<End> m_ends;
+    std::vector<size_t> m_num_points;
+    std::vector<Part> m_parts;
+    std::vector<size_t> m_line_starts;
+
+    // Walks from the line end start through the joined ends
+    void walk(size_t start, const std::vector<size_t> &joined,
+              std::vector<bool> &done, size_t max_points)
+    {
+        size_t points = 0;
+        m_line_starts.push_back(m_parts.size());
+        for (size_t end = start; end != no_end && !done[end / 2];) {
+            const size_t line = end / 2;
+            if (points > 0 && points + m_num_points[line] - 1 > max_points) {
+                m_line_starts.push_back(m_parts.size());
+                points = 0;
+            }
+            points += points > 0 ? m_num_points[line] - 1 : m_num_points[line];
+            // Entered through the last point, so walk it backwards
+            const bool reversed = end % 2 == 1;
+            m_parts.push_back({line, reversed});
+            done[line] = true;
+            // Continue at whatever is joined to the other end
+            end = joined[reversed ? end - 1 : end + 1];
+        }
+    }
+};
+
+#endif // LINEMERGER_HPP
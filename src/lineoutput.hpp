@@ -0,0 +1,236 @@
+#ifndef LINEOUTPUT_HPP
+#define LINEOUTPUT_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <osmium/osm/types.hpp>
+
+#include "options.hpp"
+#include "output.hpp"
+#include "pgcopy.hpp"
+#include "projection.hpp"
+#include "rowsorter.hpp"
+
+/// The columns of an output line apart from its ID and geometry
+struct LineAttributes
+{
+    int admin_level;
+    bool dividing_line;
+    bool disputed;
+    bool maritime;
+};
+
+/**
+ * One output file with its format and the SRS of its geometries. All
+ * outputs are written from the same ways, so several projections cost a
+ * single run over the input.
+ */
+class LineOutput
+{
+    OutputFile m_file;
+    const output_format m_format;
+    const BatchProjection m_projection;
+    // Simplification tolerance in meters, 0 for full resolution
+    const double m_tolerance;
+    // The shard of the rows this file gets
+    const unsigned int m_shard;
+    const unsigned int m_num_shards;
+    const shard_method m_shard_by;
+    // Sorts the rows if they are written in Hilbert order
+    std::unique_ptr<RowSorter> m_sorter;
+
+    void append_columns(
+        std::string &out, osmium::object_id_type id,
+        const LineAttributes &attributes, const std::string &linestring,
+        const std::vector<osmium::object_id_type> *way_ids,
+        uint64_t sort_key) const
+    {
+        if (m_sorter) {
+            const size_t start = RowSorter::begin_row(out, sort_key);
+            append_row(out, id, attributes, linestring, way_ids);
+            RowSorter::end_row(out, start);
+        } else {
+            append_row(out, id, attributes, linestring, way_ids);
+        }
+    }
+
+    void append_row(std::string &out, osmium::object_id_type id,
+                    const LineAttributes &attributes,
+                    const std::string &linestring,
+                    const std::vector<osmium::object_id_type> *way_ids) const
+    {
+        if (m_format == output_format::pgcopy_binary) {
+            pgcopy::append_tuple_start(out, way_ids ? 7 : 6);
+            pgcopy::append_field_int64(out, id);
+            pgcopy::append_field_int32(out, attributes.admin_level);
+            pgcopy::append_field_bool(out, attributes.dividing_line);
+            pgcopy::append_field_bool(out, attributes.disputed);
+            pgcopy::append_field_bool(out, attributes.maritime);
+            pgcopy::append_field_bytes(out, linestring);
+            if (way_ids) {
+                pgcopy::append_field_int64_array(out, *way_ids);
+            }
+            return;
+        }
+
+        append_int(out, id);
+        out.push_back('\t');
+        append_int(out, attributes.admin_level);
+        out.push_back('\t');
+        append_bool(out, attributes.dividing_line);
+        out.push_back('\t');
+        append_bool(out, attributes.disputed);
+        out.push_back('\t');
+        append_bool(out, attributes.maritime);
+        out.push_back('\t');
+        append_hex(out, linestring.data(), linestring.size());
+        if (way_ids) {
+            // Array literal, e.g. {1,2,3}
+            out.append("\t{", 2);
+            for (size_t i = 0; i < way_ids->size(); ++i) {
+                if (i > 0) {
+                    out.push_back(',');
+                }
+                append_int(out, (*way_ids)[i]);
+            }
+            out.push_back('}');
+        }
+        out.push_back('\n');
+    }
+
+public:
+    /**
+     * With hilbert_order the rows are written sorted by the sort key
+     * given to append_line(). They are kept in a temporary file next to
+     * the output until write_trailer().
+     */
+    LineOutput(const OutputSpec &spec, output_format format,
+               bool hilbert_order = false)
+    : m_file(spec.filename), m_format(format), m_projection(spec.epsg),
+      m_tolerance(spec.tolerance), m_shard(spec.shard),
+      m_num_shards(spec.num_shards), m_shard_by(spec.shard_by),
+      m_sorter(hilbert_order ? new RowSorter{spec.filename + ".unsorted"}
+                             : nullptr)
+    {
+    }
+
+    const BatchProjection &projection() const { return m_projection; }
+
+    /// Lines are simplified with this tolerance in meters if it isn't 0
+    double tolerance() const { return m_tolerance; }
+
+    /// Does this output use the sort key given to accepts() and append_line()?
+    bool needs_sort_key() const
+    {
+        return m_sorter ||
+               (m_num_shards > 1 && m_shard_by == shard_method::space);
+    }
+
+    /**
+     * Does the line with this ID and Hilbert key belong in this file?
+     * Always true unless the output is split into shards.
+     */
+    bool accepts(osmium::object_id_type id, uint64_t sort_key) const
+    {
+        if (m_num_shards <= 1) {
+            return true;
+        }
+        if (m_shard_by == shard_method::space) {
+            // Equal ranges of the Hilbert curve
+            return ((sort_key >> 32) * m_num_shards) >> 32 == m_shard;
+        }
+        // splitmix64 finalizer, so consecutive IDs spread evenly
+        uint64_t hash = static_cast<uint64_t>(id);
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+        hash ^= hash >> 31;
+        return hash % m_num_shards == m_shard;
+    }
+
+    /// Writes anything the output format needs before the first line
+    void write_header()
+    {
+        if (m_format == output_format::pgcopy_binary) {
+            pgcopy::append_header(m_file.buffer());
+        }
+    }
+
+    /**
+     * Writes anything the output format needs after the last line. Sorted
+     * rows are written here, before the trailer.
+     */
+    void write_trailer()
+    {
+        if (m_sorter) {
+            m_sorter->write_sorted(m_file);
+            m_sorter.reset();
+        }
+        if (m_format == output_format::pgcopy_binary) {
+            pgcopy::append_trailer(m_file.buffer());
+        }
+    }
+
+    /**
+     * Appends the line for a way to out. The EWKB geometry must be in the
+     * projection of this output. sort_key is the Hilbert key of the line,
+     * see bbox_hilbert_key(). This doesn't touch the file, so several
+     * threads can call it at once.
+     */
+    void append_line(std::string &out, osmium::object_id_type id,
+                     const LineAttributes &attributes,
+                     const std::string &linestring, uint64_t sort_key) const
+    {
+        append_columns(out, id, attributes, linestring, nullptr, sort_key);
+    }
+
+    /**
+     * Appends a line merged from several ways. The ID is the one of the
+     * first way, and all IDs are written to an extra bigint[] column.
+     */
+    void append_line(std::string &out,
+                     const std::vector<osmium::object_id_type> &way_ids,
+                     const LineAttributes &attributes,
+                     const std::string &linestring, uint64_t sort_key) const
+    {
+        append_columns(out, way_ids.front(), attributes, linestring,
+                       &way_ids, sort_key);
+    }
+
+    /// Writes lines built with append_line()
+    void write(const std::string &lines)
+    {
+        if (m_sorter) {
+            m_sorter->add_rows(lines);
+        } else {
+            m_file.write(lines);
+        }
+    }
+
+    void close() { m_file.close(); }
+};
+
+#endif // LINEOUTPUT_HPP
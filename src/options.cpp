@@ -20,10 +20,14 @@
 */
 
 #include <cstdlib>
+#include <cstring>
 #include <getopt.h>
 #include <iostream>
+#include <set>
+#include <string>
 
 #include "options.hpp"
+#include "projection.hpp"
 #include "return_codes.hpp"
 
 #ifdef _MSC_VER
@@ -31,37 +35,118 @@
 #endif
 
 Options::Options(int argc, char *argv[])
-: inputfile(), debug(false), output_file(), overwrite_output(false),
-  verbose(false)
+: inputfile(), debug(false), outputs(), generalizations(), shards(1),
+  shard_by(shard_method::id), format(output_format::text),
+  overwrite_output(false), epsg(BatchProjection::epsg_mercator),
+  verbose(false), hilbert_order(false), merge(false), merge_max_points(1000),
+  threads(1), stats_file(), trace_file(), index_type("sparse_mem_array")
 {
     static struct option long_options[] = {
         {"debug", no_argument, 0, 'd'},
+        {"epsg", required_argument, 0, 'e'},
+        {"format", required_argument, 0, 'F'},
+        {"generalize", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
+        {"hilbert-order", no_argument, 0, 'H'},
+        {"index-type", required_argument, 0, 'i'},
+        {"merge", no_argument, 0, 'm'},
+        {"merge-max-points", required_argument, 0, 'M'},
         {"output-file", required_argument, 0, 'o'},
         {"overwrite", no_argument, 0, 'f'},
+        {"shard-by", required_argument, 0, 'B'},
+        {"shards", required_argument, 0, 'S'},
+        {"stats-file", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 't'},
+        {"trace", required_argument, 0, 'T'},
         {"verbose", no_argument, 0, 'v'},
         {"version", no_argument, 0, 'V'},
         {0, 0, 0, 0}};
 
     while (1) {
-        int c = getopt_long(argc, argv, "dho:fvV", long_options, 0);
+        int c = getopt_long(argc, argv, "B:de:F:g:hHi:mM:o:fs:S:t:T:vV",
+                            long_options, 0);
         if (c == -1)
             break;
 
         switch (c) {
+        case 'B':
+            if (!strcasecmp(optarg, "id")) {
+                shard_by = shard_method::id;
+            } else if (!strcasecmp(optarg, "space")) {
+                shard_by = shard_method::space;
+            } else {
+                std::cerr << "Unknown shard method '" << optarg
+                          << "'. Use 'id' or 'space'.\n";
+                std::exit(return_code_cmdline);
+            }
+            break;
         case 'd':
             debug = true;
             std::cerr << "Enabled debug option\n";
             break;
+        case 'e':
+            epsg = get_epsg(optarg);
+            break;
+        case 'F':
+            if (!strcasecmp(optarg, "text")) {
+                format = output_format::text;
+            } else if (!strcasecmp(optarg, "pgcopy-binary")) {
+                format = output_format::pgcopy_binary;
+            } else {
+                std::cerr << "Unknown output format '" << optarg
+                          << "'. Use 'text' or 'pgcopy-binary'.\n";
+                std::exit(return_code_cmdline);
+            }
+            break;
+        case 'g':
+            parse_generalizations(optarg);
+            break;
         case 'h':
             print_help();
             std::exit(return_code_ok);
+        case 'H':
+            hilbert_order = true;
+            break;
+        case 'i':
+            index_type = optarg;
+            break;
+        case 'm':
+            merge = true;
+            break;
+        case 'M':
+            if (std::atoi(optarg) < 2) {
+                std::cerr << "The maximum number of points must be at "
+                             "least 2.\n";
+                std::exit(return_code_cmdline);
+            }
+            merge_max_points = std::atoi(optarg);
+            break;
         case 'o':
-            output_file = optarg;
+            outputs.push_back(parse_output(optarg));
             break;
         case 'f':
             overwrite_output = true;
             break;
+        case 's':
+            stats_file = optarg;
+            break;
+        case 'S':
+            if (std::atoi(optarg) < 1) {
+                std::cerr << "The number of shards must be at least 1.\n";
+                std::exit(return_code_cmdline);
+            }
+            shards = std::atoi(optarg);
+            break;
+        case 't':
+            if (std::atoi(optarg) < 1) {
+                std::cerr << "The number of threads must be at least 1.\n";
+                std::exit(return_code_cmdline);
+            }
+            threads = std::atoi(optarg);
+            break;
+        case 'T':
+            trace_file = optarg;
+            break;
         case 'v':
             verbose = true;
             break;
@@ -85,11 +170,55 @@ Options::Options(int argc, char *argv[])
         std::exit(return_code_cmdline);
     }
 
-    if (output_file.empty()) {
+    if (outputs.empty()) {
         std::cerr << "Missing --output-file/-o option.\n";
         std::exit(return_code_cmdline);
     }
 
+    // --epsg can come after the outputs it applies to
+    for (auto &output : outputs) {
+        if (output.epsg == 0) {
+            output.epsg = epsg;
+        }
+    }
+
+    const size_t full_outputs = outputs.size();
+    for (const auto &generalization : generalizations) {
+        for (size_t i = 0; i < full_outputs; ++i) {
+            OutputSpec spec = outputs[i];
+            spec.filename = insert_suffix(
+                spec.filename, "_z" + std::to_string(generalization.zoom));
+            spec.tolerance = generalization.tolerance;
+            outputs.push_back(spec);
+        }
+    }
+
+    if (shards > 1) {
+        std::vector<OutputSpec> sharded;
+        for (const auto &output : outputs) {
+            for (unsigned int shard = 0; shard < shards; ++shard) {
+                OutputSpec spec = output;
+                spec.filename = insert_suffix(
+                    spec.filename, "_s" + std::to_string(shard));
+                spec.shard = shard;
+                spec.num_shards = shards;
+                spec.shard_by = shard_by;
+                sharded.push_back(spec);
+            }
+        }
+        outputs.swap(sharded);
+    }
+
+    // Two outputs with the same name would both truncate and write the file
+    std::set<std::string> filenames;
+    for (const auto &output : outputs) {
+        if (!filenames.insert(output.filename).second) {
+            std::cerr << "Output file '" << output.filename
+                      << "' is given more than once.\n";
+            std::exit(return_code_cmdline);
+        }
+    }
+
     inputfile = argv[optind];
 }
 
@@ -97,12 +226,137 @@ void Options::print_help() const
 {
     std::cout << "osmborder [OPTIONS] OSMFILE\n"
               << "\nOptions:\n"
+              << "  -g, --generalize=Z:TOL,... - Also write outputs for zoom "
+                 "Z simplified\n"
+              << "                               with TOL meters "
+                 "tolerance\n"
               << "  -h, --help                 - This help message\n"
               << "  -d, --debug                - Enable debugging output\n"
+              << "  -e, --epsg=EPSGCODE        - EPSG code of output "
+                 "geometries, 3857 (default) or 4326\n"
               << "  -f, --overwrite            - Overwrite output file if it "
                  "already exists\n"
-              << "  -o, --output-file=FILE     - file for output\n"
+              << "  -F, --format=FORMAT        - Output format, 'text' "
+                 "(default) or 'pgcopy-binary'\n"
+              << "  -H, --hilbert-order        - Write rows in Hilbert curve "
+                 "order\n"
+              << "  -i, --index-type=TYPE      - Node location index type "
+                 "(default: sparse_mem_array)\n"
+              << "  -m, --merge                - Join adjacent ways with the "
+                 "same attributes\n"
+              << "  -M, --merge-max-points=N   - Maximum points of joined "
+                 "lines (default: 1000)\n"
+              << "  -o, --output-file=FILE     - file for output, "
+                 "FILE:EPSGCODE to use\n"
+              << "                               another SRS, can be "
+                 "given several times\n"
+              << "  -s, --stats-file=FILE      - Write counters and timings "
+                 "as JSON to FILE\n"
+              << "  -S, --shards=N             - Split every output into N "
+                 "files\n"
+              << "  -B, --shard-by=METHOD      - Split by 'id' (default) or "
+                 "'space'\n"
+              << "  -t, --threads=N            - Number of threads used to "
+                 "build linestrings (default: 1)\n"
+              << "  -T, --trace=FILE           - Write a Chrome trace of the "
+                 "run to FILE\n"
               << "  -v, --verbose              - Verbose output\n"
               << "  -V, --version              - Show version and exit\n"
+              << "\nIndex types:\n"
+              << "  sparse_mem_array           - 16 bytes per stored node in "
+                 "memory (default)\n"
+              << "  flex_mem                   - Sparse, switches to dense "
+                 "when many nodes are stored\n"
+              << "  dense_mmap_array           - 8 bytes per node ID up to the "
+                 "largest ID, anonymous mmap\n"
+              << "  dense_file_array[,FILE]    - Like dense_mmap_array, but "
+                 "backed by FILE on disk\n"
+              << "  sparse_file_array[,FILE]   - Like sparse_mem_array, but "
+                 "backed by FILE on disk\n"
               << "\n";
 }
+
+int Options::get_epsg(const char *text)
+{
+    if (!strcasecmp(text, "WGS84") || !std::strcmp(text, "4326")) {
+        return BatchProjection::epsg_wgs84;
+    }
+    if (!std::strcmp(text, "3857")) {
+        return BatchProjection::epsg_mercator;
+    }
+    if (!std::strcmp(text, "3785") || !std::strcmp(text, "900913")) {
+        std::cerr << "Please use code 3857 for the 'Google Mercator' "
+                     "projection!\n";
+        std::exit(return_code_cmdline);
+    }
+    std::cerr << "Unknown SRS '" << text
+              << "'. Currently only 4326 (WGS84) and 3857 ('Google "
+                 "Mercator') are supported.\n";
+    std::exit(return_code_cmdline);
+}
+
+OutputSpec Options::parse_output(const std::string &text)
+{
+    // Only a suffix that looks like an SRS is split off, so file names
+    // with colons in them still work
+    const auto colon = text.rfind(':');
+    if (colon != std::string::npos && colon + 1 < text.size()) {
+        const std::string srs = text.substr(colon + 1);
+        if (srs.find_first_not_of("0123456789") == std::string::npos ||
+            !strcasecmp(srs.c_str(), "WGS84")) {
+            return {text.substr(0, colon), get_epsg(srs.c_str()), 0, 0, 1,
+                    shard_method::id};
+        }
+    }
+    return {text, 0, 0, 0, 1, shard_method::id};
+}
+
+void Options::parse_generalizations(const char *text)
+{
+    const std::string list{text};
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string item = list.substr(start, end - start);
+        char *rest = nullptr;
+        const long zoom = std::strtol(item.c_str(), &rest, 10);
+        double tolerance = 0;
+        if (rest != item.c_str() && *rest == ':') {
+            const char *tolerance_text = rest + 1;
+            tolerance = std::strtod(tolerance_text, &rest);
+            if (rest == tolerance_text || *rest != '\0') {
+                tolerance = 0;
+            }
+        }
+        if (zoom < 0 || zoom > 30 || tolerance <= 0) {
+            std::cerr << "Invalid generalization '" << item
+                      << "'. Use ZOOM:TOLERANCE, e.g. 4:1000.\n";
+            std::exit(return_code_cmdline);
+        }
+        for (const auto &generalization : generalizations) {
+            if (generalization.zoom == zoom) {
+                std::cerr << "Zoom " << zoom
+                          << " is generalized more than once.\n";
+                std::exit(return_code_cmdline);
+            }
+        }
+        generalizations.push_back({static_cast<int>(zoom), tolerance});
+        start = end + 1;
+    }
+}
+
+std::string Options::insert_suffix(const std::string &filename,
+                                   const std::string &suffix)
+{
+    // The first dot of the base name, so lines.csv.gz gets lines_z4.csv.gz
+    const auto slash = filename.find_last_of("/\\");
+    const size_t base = (slash == std::string::npos) ? 0 : slash + 1;
+    const auto dot = filename.find('.', base + 1);
+    if (dot == std::string::npos) {
+        return filename + suffix;
+    }
+    return filename.substr(0, dot) + suffix + filename.substr(dot);
+}
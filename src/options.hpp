@@ -23,6 +23,45 @@
 */
 
 #include <string>
+#include <vector>
+
+/// Output formats, see --format.
+enum class output_format
+{
+    /// Tab-separated text with hex-encoded EWKB geometries
+    text,
+    /// PostgreSQL binary COPY format with raw EWKB geometries
+    pgcopy_binary
+};
+
+/// How rows are split across shards, see --shard-by.
+enum class shard_method
+{
+    /// By a hash of the OSM ID
+    id,
+    /// By ranges of the Hilbert key of the line
+    space
+};
+
+/// An output file and the EPSG code of its SRS, see --output-file.
+struct OutputSpec
+{
+    std::string filename;
+    int epsg;
+    /// Simplification tolerance in meters, 0 for full resolution
+    double tolerance;
+    /// This file gets the rows of shard number shard of num_shards
+    unsigned int shard;
+    unsigned int num_shards;
+    shard_method shard_by;
+};
+
+/// A generalized copy of the outputs, see --generalize.
+struct Generalization
+{
+    int zoom;
+    double tolerance;
+};
 
 /**
  * This class encapsulates the command line parsing.
@@ -37,18 +76,52 @@ public:
     /// Show debug output?
     bool debug;
 
-    /// Output file name.
-    std::string output_file;
+    /// Output files, all written in the same run. This includes the
+    /// generalized outputs.
+    std::vector<OutputSpec> outputs;
+
+    /// Zoom levels and tolerances of the generalized outputs.
+    std::vector<Generalization> generalizations;
+
+    /// Number of files every output is split into.
+    unsigned int shards;
+
+    /// How rows are assigned to shards.
+    shard_method shard_by;
+
+    /// Format of the output file.
+    output_format format;
 
     /// Should output database be overwritten
     bool overwrite_output;
 
-    /// EPSG code of output SRS.
+    /// EPSG code of output SRS, used for outputs without their own.
     int epsg;
 
     /// Verbose output?
     bool verbose;
 
+    /// Write the rows sorted along a Hilbert curve?
+    bool hilbert_order;
+
+    /// Join adjacent ways with the same attributes?
+    bool merge;
+
+    /// Maximum number of points of a line joined from several ways.
+    size_t merge_max_points;
+
+    /// Number of threads used to build the linestrings.
+    unsigned int threads;
+
+    /// Name of the JSON run report file, empty for no report.
+    std::string stats_file;
+
+    /// Name of the Chrome trace file, empty for no tracing.
+    std::string trace_file;
+
+    /// Node location index type, with an optional ",FILE" for file maps.
+    std::string index_type;
+
     Options(int argc, char *argv[]);
 
 private:
@@ -59,6 +132,23 @@ private:
      */
     int get_epsg(const char *text);
 
+    /**
+     * Splits an --output-file argument of the form FILE[:EPSG] into the
+     * file name and the EPSG code, which is 0 if there is none.
+     */
+    OutputSpec parse_output(const std::string &text);
+
+    /// Parses a --generalize list like "4:1000,8:100".
+    void parse_generalizations(const char *text);
+
+    /**
+     * Inserts suffix before the extension of a file name, e.g. gives
+     * lines_z4.csv for lines.csv and "_z4". Used for the names of
+     * generalized and sharded outputs.
+     */
+    static std::string insert_suffix(const std::string &filename,
+                                     const std::string &suffix);
+
     void print_help() const;
 
 }; // class Options
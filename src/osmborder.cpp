@@ -21,8 +21,12 @@
 */
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <vector>
 
 #ifndef _MSC_VER
 #include <unistd.h>
@@ -30,7 +34,6 @@
 #include <io.h>
 #endif
 
-#include <osmium/geom/wkb.hpp>
 #include <osmium/handler.hpp>
 #include <osmium/handler/node_locations_for_ways.hpp>
 #include <osmium/index/map/all.hpp>
@@ -55,9 +58,13 @@ class Way;
 }
 
 #include "adminhandler.hpp"
+#include "hex.hpp"
+#include "json.hpp"
+#include "lineoutput.hpp"
 #include "options.hpp"
 #include "return_codes.hpp"
 #include "stats.hpp"
+#include "trace.hpp"
 
 // Global debug marker
 bool debug;
@@ -78,43 +85,159 @@ std::string memory_usage()
 
 /* ================================================== */
 
-// This class acts like NodeLocationsForWays but only stores specific nodes
-// Also, only positive. TODO: Add in negative support
-template <typename TStoragePosIDs>
+// Memory use and lookup cost of the node location index types
+std::string index_description(const std::string &index_type)
+{
+    static const std::map<std::string, const char *> descriptions = {
+        {"sparse_mem_array",
+         "16 bytes per stored node in memory, O(log n) lookup"},
+        {"sparse_mmap_array",
+         "16 bytes per stored node in anonymous mmap, O(log n) lookup"},
+        {"sparse_file_array",
+         "16 bytes per stored node in a file, O(log n) lookup"},
+        {"sparse_mem_map",
+         "about 48 bytes per stored node in memory, O(log n) lookup"},
+        {"dense_mem_array",
+         "8 bytes per node ID up to the largest ID in memory, O(1) lookup"},
+        {"dense_mmap_array", "8 bytes per node ID up to the largest ID in "
+                             "anonymous mmap, O(1) lookup"},
+        {"dense_file_array",
+         "8 bytes per node ID up to the largest ID in a file, O(1) lookup"},
+        {"flex_mem", "16 bytes per stored node while sparse, O(log n) "
+                     "lookup, switching to dense O(1) for large inputs"}};
+
+    const auto it =
+        descriptions.find(index_type.substr(0, index_type.find(',')));
+    if (it == descriptions.end()) {
+        return "no description available";
+    }
+    return it->second;
+}
+
+/* ================================================== */
+
+// Like osmium::apply() on a reader, but with trace spans for waiting on
+// each buffer from the reader threads and for handling it
+template <typename THandler>
+void apply_traced(osmium::io::Reader &reader, THandler &handler)
+{
+    while (true) {
+        osmium::memory::Buffer buffer;
+        {
+            TraceSpan span{"read buffer", "input"};
+            buffer = reader.read();
+        }
+        if (!buffer) {
+            break;
+        }
+        TraceSpan span{"handle buffer", "input"};
+        osmium::apply(buffer, handler);
+    }
+}
+
+/* ================================================== */
+
+// Writes the counters and pass timings as a JSON report
+void write_stats_file(const std::string &filename, const std::string &input,
+                      const Stats &stats, unsigned int warnings)
+{
+    nlohmann::json report;
+    report["version"] = OSMBORDER_VERSION;
+    report["input"] = input;
+    report["relations"] = stats.relations;
+    report["way_members"] = stats.way_members;
+    report["ways"] = stats.ways;
+    report["nodes"] = stats.nodes;
+    report["nodes_stored"] = stats.nodes_stored;
+    report["missing_locations"] = stats.missing_locations;
+    report["geometry_errors"] = stats.geometry_errors;
+
+    uint64_t lines = 0;
+    report["lines_by_flags"] = nlohmann::json::array();
+    for (int flags = 0; flags < 8; ++flags) {
+        lines += stats.lines_by_flags[flags];
+        report["lines_by_flags"].push_back(
+            {{"dividing_line", (flags & 1) != 0},
+             {"disputed", (flags & 2) != 0},
+             {"maritime", (flags & 4) != 0},
+             {"lines", stats.lines_by_flags[flags]}});
+    }
+    report["lines"] = lines;
+
+    double wall_seconds = 0;
+    double cpu_seconds = 0;
+    report["passes"] = nlohmann::json::array();
+    for (const auto &pass : stats.passes) {
+        wall_seconds += pass.wall_seconds;
+        cpu_seconds += pass.cpu_seconds;
+        report["passes"].push_back(
+            {{"name", pass.name},
+             {"wall_seconds", pass.wall_seconds},
+             {"cpu_seconds", pass.cpu_seconds},
+             {"bytes_read", pass.bytes_read},
+             {"objects", pass.objects},
+             {"objects_per_second",
+              pass.wall_seconds > 0 ? pass.objects / pass.wall_seconds : 0},
+             {"peak_memory_mb", pass.peak_memory_mb}});
+    }
+    report["wall_seconds"] = wall_seconds;
+    report["cpu_seconds"] = cpu_seconds;
+    report["peak_memory_mb"] = osmium::MemoryUsage{}.peak();
+    report["warnings"] = warnings;
+
+    OutputFile file{filename};
+    file.write(report.dump(4));
+    file.write("\n");
+    file.close();
+}
+
+/* ================================================== */
+
+// This class acts like NodeLocationsForWays but only stores specific nodes.
+// Locations of nodes with negative IDs go into a separate index, so files
+// with locally added objects work without renumbering them first.
+template <typename TStoragePosIDs, typename TStorageNegIDs,
+          typename TNodeIdSet>
 class SpecificNodeLocationsForWays
-    : public osmium::handler::NodeLocationsForWays<TStoragePosIDs>
+    : public osmium::handler::NodeLocationsForWays<TStoragePosIDs,
+                                                   TStorageNegIDs>
 {
+    typedef osmium::handler::NodeLocationsForWays<TStoragePosIDs,
+                                                  TStorageNegIDs>
+        base_type;
+
+    // IDs of the nodes whose locations are kept, usually collected in pass 2
+    const TNodeIdSet &m_node_ids;
+    uint64_t m_nodes_read = 0;
+    uint64_t m_nodes_stored = 0;
 
-    // some var for a set of IDs to keep
 public:
-    explicit SpecificNodeLocationsForWays(TStoragePosIDs &storage_pos)
-    : osmium::handler::NodeLocationsForWays<TStoragePosIDs>(storage_pos)
+    SpecificNodeLocationsForWays(TStoragePosIDs &storage_pos,
+                                 TStorageNegIDs &storage_neg,
+                                 const TNodeIdSet &node_ids)
+    : base_type(storage_pos, storage_neg), m_node_ids(node_ids)
     {
     }
 
     void node(const osmium::Node &node)
     {
-        if (true) {
-            osmium::handler::NodeLocationsForWays<TStoragePosIDs>::node(node);
+        ++m_nodes_read;
+        if (m_node_ids.get(node.id())) {
+            ++m_nodes_stored;
+            base_type::node(node);
         }
     }
-    void way(osmium::Way &way)
-    {
-        osmium::handler::NodeLocationsForWays<TStoragePosIDs>::way(way);
-    }
-};
+    void way(osmium::Way &way) { base_type::way(way); }
 
-// TODO: Cover all admin_levels
-// This is a map instead of something like an array of chars because admin_levels can extend past 9
-const std::map<std::string, const int> AdminHandler::admin_levels = {
-    {"2", 2}, {"3", 3}, {"4", 4},   {"5", 5},   {"6", 6},  {"7", 7},
-    {"8", 8}, {"9", 9}, {"10", 10}, {"11", 11}, {"12", 12}};
+    uint64_t nodes_read() const { return m_nodes_read; }
+
+    uint64_t nodes_stored() const { return m_nodes_stored; }
+};
 
 int main(int argc, char *argv[])
 {
     Stats stats;
     unsigned int warnings = 0;
-    unsigned int errors = 0;
 
     // Parse command line and setup 'options' object with them.
     Options options(argc, argv);
@@ -126,52 +249,205 @@ int main(int argc, char *argv[])
 
     debug = options.debug;
 
-    vout << "Writing to file '" << options.output_file << "'.\n";
+    if (!options.trace_file.empty()) {
+        tracer().enable();
+    }
 
-    std::ofstream output(options.output_file);
+    const auto &map_factory =
+        osmium::index::MapFactory<osmium::unsigned_object_id_type,
+                                  osmium::Location>::instance();
+    const std::string index_name =
+        options.index_type.substr(0, options.index_type.find(','));
+    if (!map_factory.has_map_type(index_name)) {
+        std::cerr << "Unknown index type '" << index_name
+                  << "'. Available types:";
+        for (const auto &map_type : map_factory.map_types()) {
+            std::cerr << " " << map_type;
+        }
+        std::cerr << "\n";
+        std::exit(return_code_cmdline);
+    }
 
-    osmium::io::File infile{argv[optind]};
+    try {
+        // All outputs share the reading passes and the node location index
+        std::vector<std::unique_ptr<LineOutput>> outputs;
+        std::vector<LineOutput *> output_ptrs;
+        for (const auto &spec : options.outputs) {
+            vout << "Writing to file '" << spec.filename << "' in EPSG:"
+                 << spec.epsg;
+            if (spec.tolerance > 0) {
+                vout << ", simplified with " << spec.tolerance
+                     << "m tolerance";
+            }
+            if (spec.num_shards > 1) {
+                vout << ", shard " << spec.shard + 1 << " of "
+                     << spec.num_shards;
+            }
+            vout << ".\n";
+            outputs.emplace_back(new LineOutput{spec, options.format,
+                                                options.hilbert_order});
+            output_ptrs.push_back(outputs.back().get());
+        }
+        if (options.format == output_format::text) {
+            vout << "Hex encoding geometries with the '"
+                 << hex_encode_kernel() << "' kernel.\n";
+        }
 
-    AdminHandler admin_handler(output);
+        osmium::io::File infile{argv[optind]};
 
-    {
-        vout << "Reading relations in pass 1.\n";
-        osmium::io::Reader reader(infile, osmium::osm_entity_bits::relation);
-        osmium::apply(reader, admin_handler);
-        reader.close();
-        vout << memory_usage();
-    }
-    {
-        vout << "Reading ways pass 2.\n";
-        osmium::io::Reader reader(infile, osmium::osm_entity_bits::way);
-        osmium::apply(reader, admin_handler.m_handler_pass2);
-        reader.close();
-        vout << memory_usage();
-    }
-    typedef osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type,
-                                                osmium::Location>
-        index_type;
-    typedef SpecificNodeLocationsForWays<index_type> location_handler_type;
-    index_type index;
-    location_handler_type location_handler{index};
-    {
-        vout << "Reading nodes pass 3.\n";
-        osmium::io::Reader reader(infile, osmium::osm_entity_bits::node);
-        osmium::apply(reader, location_handler);
-        reader.close();
-        vout << memory_usage();
+        AdminHandler admin_handler(output_ptrs);
+        if (options.merge) {
+            admin_handler.enable_merge(options.merge_max_points);
+        }
+        if (!options.generalizations.empty()) {
+            admin_handler.enable_shared_nodes();
+        }
+
+        {
+            vout << "Reading relations in pass 1.\n";
+            PassTimer timer;
+            TraceSpan span{"pass 1 relations", "pass"};
+            osmium::io::Reader reader(infile,
+                                      osmium::osm_entity_bits::relation);
+            apply_traced(reader, admin_handler);
+            const uint64_t bytes_read = reader.offset();
+            reader.close();
+            admin_handler.sort_way_relations();
+            stats.relations = admin_handler.relations_count();
+            stats.way_members = admin_handler.way_relations_count();
+            stats.passes.push_back(timer.finish(
+                "relations", bytes_read, admin_handler.relations_read()));
+            vout << "Found " << admin_handler.relations_count()
+                 << " boundary relations with "
+                 << admin_handler.way_relations_count() << " way members.\n";
+            vout << memory_usage();
+        }
+        {
+            vout << "Reading ways pass 2.\n";
+            PassTimer timer;
+            TraceSpan span{"pass 2 ways", "pass"};
+            osmium::io::Reader reader(infile, osmium::osm_entity_bits::way);
+            apply_traced(reader, admin_handler.m_handler_pass2);
+            const uint64_t bytes_read = reader.offset();
+            reader.close();
+            stats.ways = admin_handler.ways_count();
+            stats.nodes = admin_handler.get_node_ids().size();
+            stats.passes.push_back(
+                timer.finish("ways", bytes_read, admin_handler.ways_read()));
+            vout << "Found " << admin_handler.get_node_ids().size()
+                 << " nodes on boundary ways.\n";
+            vout << memory_usage();
+        }
+        typedef osmium::index::map::Map<osmium::unsigned_object_id_type,
+                                        osmium::Location>
+            index_type;
+        // Negative IDs are rare, so they always use a sparse index
+        typedef osmium::index::map::SparseMemArray<
+            osmium::unsigned_object_id_type, osmium::Location>
+            negative_index_type;
+        typedef SpecificNodeLocationsForWays<index_type, negative_index_type,
+                                             AdminHandler::NodeIdSet>
+            location_handler_type;
+        vout << "Using node location index '" << options.index_type
+             << "': " << index_description(options.index_type) << ".\n";
+        std::unique_ptr<index_type> index =
+            map_factory.create_map(options.index_type);
+        negative_index_type negative_index;
+        location_handler_type location_handler{*index, negative_index,
+                                               admin_handler.get_node_ids()};
+        // Ways with missing nodes are reported as geometry errors
+        location_handler.ignore_errors();
+        {
+            vout << "Reading nodes pass 3.\n";
+            PassTimer timer;
+            TraceSpan span{"pass 3 nodes", "pass"};
+            osmium::io::Reader reader(infile, osmium::osm_entity_bits::node);
+            apply_traced(reader, location_handler);
+            const uint64_t bytes_read = reader.offset();
+            reader.close();
+            stats.nodes_stored = location_handler.nodes_stored();
+            stats.passes.push_back(timer.finish(
+                "nodes", bytes_read, location_handler.nodes_read()));
+            vout << "Node location index holds " << index->size()
+                 << " locations in " << index->used_memory() / (1024 * 1024)
+                 << " MBytes.\n";
+            if (negative_index.size() > 0) {
+                vout << "Negative ID index holds " << negative_index.size()
+                     << " locations in "
+                     << negative_index.used_memory() / (1024 * 1024)
+                     << " MBytes.\n";
+            }
+            vout << memory_usage();
+        }
+        {
+            // The ways from pass 2 are already in memory, so there is no need
+            // to read the input file a fourth time.
+            vout << "Looking up node locations.\n";
+            PassTimer timer;
+            TraceSpan span{"linestrings", "pass"};
+            {
+                TraceSpan lookup_span{"look up locations", "geometry"};
+                osmium::apply(admin_handler.get_ways(), location_handler);
+            }
+            stats.missing_locations = admin_handler.missing_locations();
+            if (stats.missing_locations > 0) {
+                vout << stats.missing_locations
+                     << " node locations are missing.\n";
+            }
+            vout << "Building linestrings with " << options.threads
+                 << " threads.\n";
+            admin_handler.write_header();
+            admin_handler.build_linestrings(options.threads);
+            if (options.hilbert_order) {
+                vout << "Writing rows in Hilbert order.\n";
+            }
+            admin_handler.write_trailer();
+            if (options.merge) {
+                vout << "Wrote " << admin_handler.merged_lines_count()
+                     << " merged lines.\n";
+            }
+            for (auto &output : outputs) {
+                output->close();
+            }
+            const auto &line_counts = admin_handler.line_counts();
+            stats.geometry_errors = line_counts.geometry_errors;
+            std::copy(std::begin(line_counts.lines_by_flags),
+                      std::end(line_counts.lines_by_flags),
+                      std::begin(stats.lines_by_flags));
+            stats.passes.push_back(
+                timer.finish("linestrings", 0, stats.ways));
+            vout << memory_usage();
+        }
+
+        // A way without a linestring is missing in the output, but the
+        // rest of the output is still usable
+        warnings += stats.geometry_errors;
+    } catch (const std::system_error &e) {
+        std::cerr << e.what() << "\n";
+        std::exit(return_code_fatal);
     }
-    vout << "Building linestrings.\n";
-    osmium::io::Reader reader(infile, osmium::osm_entity_bits::way);
-    osmium::apply(reader, location_handler, admin_handler);
 
     vout << "All done.\n";
     vout << memory_usage();
 
     std::cerr << "There were " << warnings << " warnings.\n";
-    std::cerr << "There were " << errors << " errors.\n";
 
-    if (errors || warnings > max_warnings) {
+    try {
+        if (!options.stats_file.empty()) {
+            write_stats_file(options.stats_file, options.inputfile, stats,
+                             warnings);
+        }
+        if (!options.trace_file.empty()) {
+            OutputFile trace_file{options.trace_file};
+            trace_file.write(tracer().json());
+            trace_file.close();
+        }
+    } catch (const std::system_error &e) {
+        std::cerr << e.what() << "\n";
+        std::exit(return_code_fatal);
+    }
+
+    if (warnings > max_warnings) {
         return return_code_error;
     } else if (warnings) {
         return return_code_warning;
@@ -22,6 +22,7 @@
 
 */
 
+#include <algorithm>
 #include <cstdlib>
 #include <getopt.h>
 #include <string>
@@ -37,8 +38,8 @@
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/io/input_iterator.hpp>
+#include <osmium/io/any_output.hpp>
 #include <osmium/io/output_iterator.hpp>
-#include <osmium/io/pbf_output.hpp>
 #include <osmium/osm/box.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/node_ref.hpp>
@@ -50,6 +51,7 @@
 // #include <osmium/handler.hpp>
 // #include <osmium/visitor.hpp>
 
+#include "idset.hpp"
 #include "return_codes.hpp"
 #include "json.hpp"
 
@@ -278,8 +280,9 @@ int main(int argc, char *argv[])
 
 		auto output_it = osmium::io::make_output_iterator(writer);
 
-		std::vector<osmium::object_id_type> way_ids;
-		std::vector<osmium::object_id_type> node_ids;
+		// Bitmaps, so there is nothing to sort and lookups are cheap
+		IdSet way_ids;
+		IdSet node_ids;
 
 		vout << "Reading relations (1st pass through input file)...\n";
 		{
@@ -300,7 +303,7 @@ int main(int argc, char *argv[])
 					*output_it++ = relation;
 					for (const auto &rm : relation.members()) {
 						if (rm.type() == osmium::item_type::way) {
-							way_ids.push_back(rm.ref());
+							way_ids.set(rm.ref());
 						}
 					}
 				}
@@ -308,9 +311,6 @@ int main(int argc, char *argv[])
 			reader.close();
 		}
 
-		vout << "Preparing way ID list...\n";
-		std::sort(way_ids.begin(), way_ids.end());
-
 		vout << "Reading ways (2nd pass through input file)...\n";
 
 		{
@@ -318,16 +318,8 @@ int main(int argc, char *argv[])
 			auto ways =
 			    osmium::io::make_input_iterator_range<const osmium::Way>(reader);
 
-			auto first = way_ids.begin();
-			auto last = std::unique(way_ids.begin(), way_ids.end());
-
 			for (const osmium::Way &way : ways) {
-				// Advance the target list to the first possible way
-				while (*first < way.id() && first != last) {
-					++first;
-				}
-
-				if (way.id() == *first) {
+				if (way_ids.get(way.id())) {
 					// *output_it++ = way;
 					// start changes for way
 					auto nway_it = waymap.find(way.id());
@@ -335,10 +327,7 @@ int main(int argc, char *argv[])
 					else handler.way(way,nway_it->second);
 					// end changes for way
 					for (const auto &nr : way.nodes()) {
-						node_ids.push_back(nr.ref());
-					}
-					if (first != last) {
-						++first;
+						node_ids.set(nr.ref());
 					}
 				}
 			}
@@ -346,28 +335,14 @@ int main(int argc, char *argv[])
 		}
 
 
-		vout << "Preparing node ID list...\n";
-		std::sort(node_ids.begin(), node_ids.end());
-		auto last = std::unique(node_ids.begin(), node_ids.end());
-
 		vout << "Reading nodes (3rd pass through input file)...\n";
 		{
 			osmium::io::Reader reader{infile, osmium::osm_entity_bits::node};
 			auto nodes = osmium::io::make_input_iterator_range<const osmium::Node>( reader);
 
-			auto first = node_ids.begin();
 			std::copy_if(nodes.cbegin(), nodes.cend(), output_it,
-			[&first, &last](const osmium::Node &node) {
-				while (*first < node.id() && first != last) {
-					++first;
-				}
-				if (node.id() == *first) {
-					if (first != last) {
-						++first;
-					}
-					return true;
-				}
-				return false;
+			[&node_ids](const osmium::Node &node) {
+				return node_ids.get(node.id());
 			});
 
 			reader.close();
@@ -0,0 +1,343 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include "compression.hpp"
+#include "hex.hpp"
+#include "trace.hpp"
+
+/**
+ * Appends the decimal representation of value to out. Unlike ostream
+ * formatting this doesn't look at the locale and doesn't allocate once
+ * out has grown large enough.
+ */
+inline void append_int(std::string &out, int64_t value)
+{
+    static const char digit_pairs[] = "00010203040506070809"
+                                      "10111213141516171819"
+                                      "20212223242526272829"
+                                      "30313233343536373839"
+                                      "40414243444546474849"
+                                      "50515253545556575859"
+                                      "60616263646566676869"
+                                      "70717273747576777879"
+                                      "80818283848586878889"
+                                      "90919293949596979899";
+    char buffer[24];
+    char *const end = buffer + sizeof(buffer);
+    char *p = end;
+
+    uint64_t v = (value < 0) ? (0 - static_cast<uint64_t>(value))
+                             : static_cast<uint64_t>(value);
+    while (v >= 100) {
+        const unsigned pair = static_cast<unsigned>(v % 100) * 2;
+        v /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (v >= 10) {
+        const unsigned pair = static_cast<unsigned>(v) * 2;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    } else {
+        *--p = static_cast<char>('0' + v);
+    }
+    if (value < 0) {
+        *--p = '-';
+    }
+    out.append(p, end);
+}
+
+inline void append_bool(std::string &out, bool value)
+{
+    if (value) {
+        out.append("true", 4);
+    } else {
+        out.append("false", 5);
+    }
+}
+
+/// Appends size bytes from data to out as upper case hex
+inline void append_hex(std::string &out, const char *data, size_t size)
+{
+    const size_t start = out.size();
+    out.resize(start + size * 2);
+    hex_encode(data, size, &out[start]);
+}
+
+/**
+ * Limits the number of frames compressed at the same time by all output
+ * files together. Without it every compressed output, and there can be
+ * dozens with generalization and shards, would start up to one thread and
+ * keep one raw buffer per hardware thread.
+ */
+class CompressionSlots
+{
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+    size_t m_free;
+
+public:
+    explicit CompressionSlots(size_t count) : m_free(count) {}
+
+    /// Takes a slot if one is free, without waiting
+    bool try_acquire()
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_free == 0) {
+            return false;
+        }
+        --m_free;
+        return true;
+    }
+
+    /// Waits for a free slot and takes it
+    void acquire()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_released.wait(lock, [this]() { return m_free > 0; });
+        --m_free;
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            ++m_free;
+        }
+        m_released.notify_one();
+    }
+};
+
+/// The compression slots shared by all output files, one per hardware thread
+inline CompressionSlots &compression_slots()
+{
+    static CompressionSlots slots{
+        std::max(2u, std::thread::hardware_concurrency())};
+    return slots;
+}
+
+/**
+ * An output file that collects data in a large buffer and writes it to
+ * the file descriptor in big blocks. Errors are reported as
+ * std::system_error.
+ *
+ * Files ending in .gz or .zst are compressed on the fly. Every full
+ * buffer becomes an independent frame which is compressed on its own
+ * thread, while the caller carries on filling the next buffer. Frames are
+ * written in order, so the file is a single valid stream. All files
+ * together compress at most one frame per hardware thread at a time, see
+ * CompressionSlots, and each file holds at most as many frames waiting to
+ * be written.
+ */
+class OutputFile
+{
+    int m_fd;
+    std::string m_buffer;
+    const compression m_compression;
+    // Frames being compressed or waiting to be written, oldest first
+    std::deque<std::future<std::string>> m_frames;
+    const size_t m_max_frames;
+
+    // Writes the oldest frame, waiting for its compression to finish
+    void write_frame()
+    {
+        const std::string frame = m_frames.front().get();
+        m_frames.pop_front();
+        write_all(frame.data(), frame.size());
+    }
+
+    void queue_frame(std::string &&data)
+    {
+        if (m_frames.size() >= m_max_frames) {
+            write_frame();
+        }
+        // Writing our own frames first means waiting for their compression,
+        // which frees their slots. Only block once none are left.
+        while (!compression_slots().try_acquire()) {
+            if (m_frames.empty()) {
+                compression_slots().acquire();
+                break;
+            }
+            write_frame();
+        }
+
+        // The slot is given back when the frame is compressed, and the raw
+        // data is freed then too because the task owns it
+        struct SlotRelease
+        {
+            ~SlotRelease() { compression_slots().release(); }
+        };
+        const compression type = m_compression;
+        try {
+            m_frames.push_back(std::async(
+                std::launch::async,
+                [type](std::string frame) {
+                    SlotRelease release;
+                    TraceSpan span{"compress", "output"};
+                    return compress_frame(type, frame);
+                },
+                std::move(data)));
+        } catch (...) {
+            compression_slots().release();
+            throw;
+        }
+    }
+
+    void write_all(const char *data, size_t size)
+    {
+        TraceSpan span{"write", "output"};
+        while (size > 0) {
+            const auto written = ::write(m_fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error{errno, std::system_category(),
+                                        "Write failed"};
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+public:
+    /// The buffer is written out once it grows beyond this size
+    static constexpr size_t buffer_size = 8 * 1024 * 1024;
+
+    explicit OutputFile(const std::string &filename)
+    : m_fd(-1), m_compression(compression_from_filename(filename)),
+      m_max_frames(std::max(2u, std::thread::hardware_concurrency()))
+    {
+        if (!compression_available(m_compression)) {
+            throw std::system_error{
+                std::make_error_code(std::errc::not_supported),
+                "Can not write '" + filename +
+                    "', osmborder was built without zstd support"};
+        }
+        m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,
+                      0666);
+        if (m_fd < 0) {
+            throw std::system_error{errno, std::system_category(),
+                                    "Can not open output file '" +
+                                        filename + "'"};
+        }
+        m_buffer.reserve(buffer_size + buffer_size / 4);
+    }
+
+    OutputFile(const OutputFile &) = delete;
+    OutputFile &operator=(const OutputFile &) = delete;
+
+    ~OutputFile()
+    {
+        try {
+            close();
+        } catch (...) {
+            // Ignore errors here, call close() to see them
+        }
+    }
+
+    /**
+     * The buffer to append data to. Call flush_if_full() now and then to
+     * keep it from growing too large.
+     */
+    std::string &buffer() { return m_buffer; }
+
+    void flush_if_full()
+    {
+        if (m_buffer.size() >= buffer_size) {
+            flush();
+        }
+    }
+
+    void write(const char *data, size_t size)
+    {
+        if (m_buffer.size() + size > buffer_size) {
+            flush();
+            if (size >= buffer_size && m_compression == compression::none) {
+                write_all(data, size);
+                return;
+            }
+        }
+        m_buffer.append(data, size);
+    }
+
+    void write(const std::string &data) { write(data.data(), data.size()); }
+
+    void flush()
+    {
+        if (m_compression == compression::none) {
+            write_all(m_buffer.data(), m_buffer.size());
+            m_buffer.clear();
+            return;
+        }
+        if (!m_buffer.empty()) {
+            std::string frame;
+            frame.swap(m_buffer);
+            m_buffer.reserve(buffer_size + buffer_size / 4);
+            queue_frame(std::move(frame));
+        }
+    }
+
+    void close()
+    {
+        if (m_fd < 0) {
+            return;
+        }
+        flush();
+        while (!m_frames.empty()) {
+            write_frame();
+        }
+        const int fd = m_fd;
+        m_fd = -1;
+        if (::close(fd) != 0) {
+            throw std::system_error{errno, std::system_category(),
+                                    "Close failed"};
+        }
+    }
+};
+
+#endif // OUTPUT_HPP
@@ -0,0 +1,119 @@
+#ifndef PGCOPY_HPP
+#define PGCOPY_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Helpers for writing the PostgreSQL binary COPY format. All integers are
+ * in network byte order, and every field is prefixed by its length.
+ */
+namespace pgcopy {
+
+inline void append_int16(std::string &out, int16_t value)
+{
+    const uint16_t v = static_cast<uint16_t>(value);
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v));
+}
+
+inline void append_int32(std::string &out, int32_t value)
+{
+    const uint32_t v = static_cast<uint32_t>(value);
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>(v >> shift));
+    }
+}
+
+inline void append_int64(std::string &out, int64_t value)
+{
+    const uint64_t v = static_cast<uint64_t>(value);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>(v >> shift));
+    }
+}
+
+/// File signature, flags field and (empty) header extension area
+inline void append_header(std::string &out)
+{
+    out.append("PGCOPY\n\377\r\n\0", 11);
+    append_int32(out, 0);
+    append_int32(out, 0);
+}
+
+inline void append_trailer(std::string &out) { append_int16(out, -1); }
+
+inline void append_tuple_start(std::string &out, int16_t num_fields)
+{
+    append_int16(out, num_fields);
+}
+
+inline void append_field_int64(std::string &out, int64_t value)
+{
+    append_int32(out, 8);
+    append_int64(out, value);
+}
+
+inline void append_field_int32(std::string &out, int32_t value)
+{
+    append_int32(out, 4);
+    append_int32(out, value);
+}
+
+inline void append_field_bool(std::string &out, bool value)
+{
+    append_int32(out, 1);
+    out.push_back(value ? 1 : 0);
+}
+
+/// Any type whose binary form is a plain byte string, e.g. EWKB geometries
+inline void append_field_bytes(std::string &out, const std::string &value)
+{
+    append_int32(out, static_cast<int32_t>(value.size()));
+    out.append(value);
+}
+
+/// A one-dimensional bigint[] without NULLs
+inline void append_field_int64_array(std::string &out,
+                                     const std::vector<int64_t> &values)
+{
+    // OID of the int8 type, as in PostgreSQL's pg_type.h
+    static constexpr int32_t int8_oid = 20;
+    const int32_t count = static_cast<int32_t>(values.size());
+    append_int32(out, 20 + count * 12);
+    append_int32(out, 1); // dimensions
+    append_int32(out, 0); // no NULLs
+    append_int32(out, int8_oid);
+    append_int32(out, count);
+    append_int32(out, 1); // lower bound
+    for (const int64_t value : values) {
+        append_int32(out, 8);
+        append_int64(out, value);
+    }
+}
+
+} // namespace pgcopy
+
+#endif // PGCOPY_HPP
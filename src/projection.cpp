@@ -0,0 +1,175 @@
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstring>
+
+#include "projection.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define OSMBORDER_PROJECTION_AVX2
+#define OSMBORDER_RESTRICT __restrict__
+#define OSMBORDER_INLINE inline __attribute__((always_inline))
+#else
+#define OSMBORDER_RESTRICT
+#define OSMBORDER_INLINE inline
+#endif
+
+namespace {
+
+constexpr double pi = 3.14159265358979323846;
+constexpr double earth_radius = 6378137.0;
+constexpr double coordinate_precision = 10000000.0;
+
+OSMBORDER_INLINE double as_double(uint64_t u)
+{
+    double d;
+    std::memcpy(&d, &u, sizeof(d));
+    return d;
+}
+
+OSMBORDER_INLINE uint64_t as_uint64(double d)
+{
+    uint64_t u;
+    std::memcpy(&u, &d, sizeof(u));
+    return u;
+}
+
+/*
+ * y = R * ln(tan(pi/4 + lat/2)) = R/2 * ln((1 + sin(lat)) / (1 - sin(lat)))
+ *
+ * sin() is a Taylor series, which is accurate to well below a double ulp
+ * for |lat| <= 85.06 degrees. ln() splits its argument into exponent and
+ * mantissa through the bit pattern and uses the atanh series on the
+ * mantissa. There are no branches or library calls, so compilers can
+ * vectorise the loop. Clamping works on the fixed point input, and the
+ * sqrt(2) range reduction uses an integer carry instead of a floating
+ * point comparison.
+ */
+OSMBORDER_INLINE void project_loop(const int32_t *OSMBORDER_RESTRICT x,
+                                   const int32_t *OSMBORDER_RESTRICT y,
+                                   size_t count,
+                                   double *OSMBORDER_RESTRICT out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        // Same operations as osmium's lon_to_x(), so x is exact
+        const double lon = static_cast<double>(x[i]) / coordinate_precision;
+        out[i * 2] = earth_radius * (lon * (pi / 180.0));
+
+        // Clamp with masks, a comparison would let the compiler split the
+        // loop body for clamped values
+        int32_t d = y[i] - mercator_max_lat_fixed;
+        int32_t fixed_lat = mercator_max_lat_fixed + (d & (d >> 31));
+        d = fixed_lat + mercator_max_lat_fixed;
+        fixed_lat = -mercator_max_lat_fixed + (d & ~(d >> 31));
+        const double phi = static_cast<double>(fixed_lat) /
+                           coordinate_precision * (pi / 180.0);
+
+        const double phi2 = phi * phi;
+        double s = 1.0 / 51090942171709440000.0; // 1/21!
+        s = s * -phi2 + 1.0 / 121645100408832000.0;
+        s = s * -phi2 + 1.0 / 355687428096000.0;
+        s = s * -phi2 + 1.0 / 1307674368000.0;
+        s = s * -phi2 + 1.0 / 6227020800.0;
+        s = s * -phi2 + 1.0 / 39916800.0;
+        s = s * -phi2 + 1.0 / 362880.0;
+        s = s * -phi2 + 1.0 / 5040.0;
+        s = s * -phi2 + 1.0 / 120.0;
+        s = s * -phi2 + 1.0 / 6.0;
+        s = s * -phi2 + 1.0;
+        s = s * phi;
+
+        const uint64_t bits = as_uint64((1.0 + s) / (1.0 - s));
+        const uint64_t mantissa = bits & 0x000fffffffffffffULL;
+        // 1 if the mantissa is above sqrt(2), then halve it and carry the
+        // factor of 2 into the exponent
+        const uint64_t above =
+            (mantissa + (0x0010000000000000ULL - 0x6a09e667f3bcdULL)) >> 52;
+        const double m = as_double(mantissa | ((1023 - above) << 52));
+        const uint64_t exponent = ((bits >> 52) & 0x7ff) + above;
+        // Integer to double without a conversion instruction
+        const double e = as_double(exponent | 0x4330000000000000ULL) -
+                         4503599627370496.0 - 1023.0;
+
+        const double f = (m - 1.0) / (m + 1.0);
+        const double f2 = f * f;
+        double l = 1.0 / 23;
+        l = l * f2 + 1.0 / 21;
+        l = l * f2 + 1.0 / 19;
+        l = l * f2 + 1.0 / 17;
+        l = l * f2 + 1.0 / 15;
+        l = l * f2 + 1.0 / 13;
+        l = l * f2 + 1.0 / 11;
+        l = l * f2 + 1.0 / 9;
+        l = l * f2 + 1.0 / 7;
+        l = l * f2 + 1.0 / 5;
+        l = l * f2 + 1.0 / 3;
+        l = l * f2 + 1.0;
+        const double ln = e * 0.69314718055994530942 + 2.0 * f * l;
+
+        out[i * 2 + 1] = earth_radius * 0.5 * ln;
+    }
+}
+
+void project_default(const int32_t *x, const int32_t *y, size_t count,
+                     double *out)
+{
+    project_loop(x, y, count, out);
+}
+
+#ifdef OSMBORDER_PROJECTION_AVX2
+// No FMA, so the results are the same as with the default kernel
+__attribute__((target("avx2"))) void
+project_avx2(const int32_t *x, const int32_t *y, size_t count, double *out)
+{
+    project_loop(x, y, count, out);
+}
+#endif
+
+typedef void (*project_func)(const int32_t *, const int32_t *, size_t,
+                             double *);
+
+project_func select_kernel()
+{
+#ifdef OSMBORDER_PROJECTION_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return project_avx2;
+    }
+#endif
+    return project_default;
+}
+
+} // anonymous namespace
+
+void mercator_project(const int32_t *x, const int32_t *y, size_t count,
+                      double *out)
+{
+    static const project_func kernel = select_kernel();
+    kernel(x, y, count, out);
+}
+
+void lonlat_project(const int32_t *x, const int32_t *y, size_t count,
+                    double *out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i * 2] = static_cast<double>(x[i]) / coordinate_precision;
+        out[i * 2 + 1] = static_cast<double>(y[i]) / coordinate_precision;
+    }
+}
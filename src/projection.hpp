@@ -0,0 +1,84 @@
+#ifndef PROJECTION_HPP
+#define PROJECTION_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+/// Latitudes beyond this are clamped, as in osmium::geom::MERCATOR_MAX_LAT
+constexpr int32_t mercator_max_lat_fixed = 850511288;
+
+/**
+ * Largest difference in meters between mercator_project() and the exact
+ * R * ln(tan(pi/4 + lat/2)) over the whole coordinate range. The x values
+ * are computed exactly like osmium's MercatorProjection.
+ */
+constexpr double mercator_tolerance = 1e-6;
+
+/**
+ * Projects count locations, given in osmium's fixed point format (degrees
+ * times 10^7), to Web Mercator. The results are written to out as x,y
+ * pairs. The work is done by a vectorised kernel, AVX2 if the CPU has it.
+ * All kernels produce identical results.
+ */
+void mercator_project(const int32_t *x, const int32_t *y, size_t count,
+                      double *out);
+
+/**
+ * Converts count locations in osmium's fixed point format to degrees,
+ * written to out as x,y pairs. The values are the same as
+ * osmium::Location::lon() and lat().
+ */
+void lonlat_project(const int32_t *x, const int32_t *y, size_t count,
+                    double *out);
+
+/**
+ * Projects all locations of a linestring in one call for
+ * EWKBLineStringBuilder. The SRS is chosen at run time, so outputs in
+ * different SRSs can be written from the same locations.
+ */
+class BatchProjection
+{
+    int m_epsg;
+
+public:
+    /// EPSG codes understood by BatchProjection
+    static constexpr int epsg_mercator = 3857;
+    static constexpr int epsg_wgs84 = 4326;
+
+    explicit BatchProjection(int epsg = epsg_mercator) : m_epsg(epsg) {}
+
+    int epsg() const { return m_epsg; }
+
+    void operator()(const int32_t *x, const int32_t *y, size_t count,
+                    double *out) const
+    {
+        if (m_epsg == epsg_wgs84) {
+            lonlat_project(x, y, count, out);
+        } else {
+            mercator_project(x, y, count, out);
+        }
+    }
+};
+
+#endif // PROJECTION_HPP
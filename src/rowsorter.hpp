@@ -0,0 +1,333 @@
+#ifndef ROWSORTER_HPP
+#define ROWSORTER_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#include "output.hpp"
+#include "trace.hpp"
+
+/**
+ * Collects output rows with a sort key and writes them in key order. Rows
+ * are collected in memory up to run_size bytes, and every full run is
+ * sorted and appended to a temporary file. write_sorted() merges the runs
+ * with sequential reads of read_size bytes per run, so memory use is about
+ * run_size plus read_size for every run, not proportional to the number of
+ * rows. Outputs that fit in one run never touch the disk.
+ *
+ * Rows are passed in as framed batches, see begin_row() and end_row(), so
+ * the framing can be done on worker threads.
+ */
+class RowSorter
+{
+    struct Row
+    {
+        uint64_t key;
+        // Position of the frame in m_run
+        size_t offset;
+        uint32_t size;
+
+        bool operator<(const Row &other) const
+        {
+            // The offset keeps rows with the same key in input order
+            return key < other.key ||
+                   (key == other.key && offset < other.offset);
+        }
+    };
+
+    // A sorted run in the temporary file while it is merged
+    struct Run
+    {
+        // Next byte to read and end of the run in the file
+        uint64_t offset;
+        uint64_t end;
+        std::string buffer;
+        // Frame of the current row in buffer
+        size_t pos;
+    };
+
+    // Size of the frame before each row: the key and the row size
+    static constexpr size_t frame_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+    // Rows kept in memory before they are sorted and written as a run
+    static constexpr size_t run_size = 64 * 1024 * 1024;
+
+    // Size of the reads from each run while merging
+    static constexpr size_t read_size = 1024 * 1024;
+
+    std::string m_filename;
+    // Created with the first full run
+    std::unique_ptr<OutputFile> m_runs_file;
+    std::vector<Run> m_runs;
+    uint64_t m_offset = 0;
+
+    // The run being collected, framed as passed to add_rows()
+    std::string m_run;
+    std::vector<Row> m_rows;
+    size_t m_count = 0;
+
+    void read_at(int fd, uint64_t offset, char *data, size_t size)
+    {
+        while (size > 0) {
+#ifndef _MSC_VER
+            const auto count =
+                ::pread(fd, data, size, static_cast<off_t>(offset));
+#else
+            _lseeki64(fd, static_cast<__int64>(offset), SEEK_SET);
+            const auto count = ::_read(fd, data, size);
+#endif
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                throw std::system_error{errno, std::system_category(),
+                                        "Read of '" + m_filename +
+                                            "' failed"};
+            }
+            data += count;
+            offset += static_cast<uint64_t>(count);
+            size -= static_cast<size_t>(count);
+        }
+    }
+
+    /// Sorts the rows in memory and appends them to the file as a run
+    void write_run()
+    {
+        TraceSpan span{"write sorted run", "output"};
+        if (!m_runs_file) {
+            m_runs_file.reset(new OutputFile{m_filename});
+        }
+        std::sort(m_rows.begin(), m_rows.end());
+
+        Run run;
+        run.offset = m_offset;
+        for (const Row &r : m_rows) {
+            m_runs_file->write(m_run.data() + r.offset, frame_size + r.size);
+            m_offset += frame_size + r.size;
+        }
+        run.end = m_offset;
+        run.pos = 0;
+        m_runs.push_back(std::move(run));
+
+        m_run.clear();
+        m_rows.clear();
+    }
+
+    /**
+     * Makes sure there are size bytes after the current row frame in the
+     * buffer of the run. Returns false at the end of the run.
+     */
+    bool fill(int fd, Run &run, size_t size)
+    {
+        if (run.buffer.size() - run.pos >= size) {
+            return true;
+        }
+        run.buffer.erase(0, run.pos);
+        run.pos = 0;
+
+        const uint64_t left = run.end - run.offset;
+        if (run.buffer.size() + left < size) {
+            return false;
+        }
+        uint64_t count = size - run.buffer.size();
+        if (count < read_size) {
+            count = read_size;
+        }
+        if (count > left) {
+            count = left;
+        }
+        const size_t old_size = run.buffer.size();
+        run.buffer.resize(old_size + static_cast<size_t>(count));
+        read_at(fd, run.offset, &run.buffer[old_size],
+                static_cast<size_t>(count));
+        run.offset += count;
+        return true;
+    }
+
+    /// Reads the next row of the run into its buffer and returns its key
+    bool next_row(int fd, Run &run, uint64_t &key)
+    {
+        if (!fill(fd, run, frame_size)) {
+            return false;
+        }
+        uint32_t size;
+        std::memcpy(&size, &run.buffer[run.pos + sizeof(key)], sizeof(size));
+        if (!fill(fd, run, frame_size + size)) {
+            throw std::runtime_error{"Truncated run in '" + m_filename + "'"};
+        }
+        std::memcpy(&key, &run.buffer[run.pos], sizeof(key));
+        return true;
+    }
+
+    /// Merges the runs in the temporary file into out
+    void merge_runs(int fd, OutputFile &out)
+    {
+        // Smallest key first, and the earlier run for equal keys, so rows
+        // with the same key stay in input order
+        using entry = std::pair<uint64_t, size_t>;
+        std::priority_queue<entry, std::vector<entry>, std::greater<entry>>
+            queue;
+
+        for (size_t i = 0; i < m_runs.size(); ++i) {
+            uint64_t key;
+            if (next_row(fd, m_runs[i], key)) {
+                queue.emplace(key, i);
+            }
+        }
+
+        while (!queue.empty()) {
+            const size_t i = queue.top().second;
+            queue.pop();
+
+            Run &run = m_runs[i];
+            uint32_t size;
+            std::memcpy(&size, &run.buffer[run.pos + sizeof(uint64_t)],
+                        sizeof(size));
+            out.write(run.buffer.data() + run.pos + frame_size, size);
+            run.pos += frame_size + size;
+
+            uint64_t key;
+            if (next_row(fd, run, key)) {
+                queue.emplace(key, i);
+            }
+        }
+    }
+
+public:
+    /// Full runs are kept in filename until write_sorted()
+    explicit RowSorter(const std::string &filename) : m_filename(filename) {}
+
+    RowSorter(const RowSorter &) = delete;
+    RowSorter &operator=(const RowSorter &) = delete;
+
+    ~RowSorter()
+    {
+        if (m_runs_file) {
+            std::remove(m_filename.c_str());
+        }
+    }
+
+    /// Starts a row in out. Returns the value for end_row().
+    static size_t begin_row(std::string &out, uint64_t key)
+    {
+        const size_t start = out.size();
+        out.resize(start + frame_size);
+        std::memcpy(&out[start], &key, sizeof(key));
+        return start;
+    }
+
+    /// Ends a row appended to out after begin_row()
+    static void end_row(std::string &out, size_t start)
+    {
+        const uint32_t size =
+            static_cast<uint32_t>(out.size() - start - frame_size);
+        std::memcpy(&out[start + sizeof(uint64_t)], &size, sizeof(size));
+    }
+
+    /// Adds all rows framed with begin_row() and end_row()
+    void add_rows(const std::string &rows)
+    {
+        const size_t base = m_run.size();
+        m_run.append(rows);
+
+        size_t pos = 0;
+        while (pos < rows.size()) {
+            Row row;
+            std::memcpy(&row.key, &rows[pos], sizeof(row.key));
+            std::memcpy(&row.size, &rows[pos + sizeof(row.key)],
+                        sizeof(row.size));
+            row.offset = base + pos;
+            m_rows.push_back(row);
+            ++m_count;
+            pos += frame_size + row.size;
+        }
+
+        if (m_run.size() >= run_size) {
+            write_run();
+        }
+    }
+
+    size_t size() const { return m_count; }
+
+    /// Writes all rows to out sorted by key and removes the temporary file
+    void write_sorted(OutputFile &out)
+    {
+        TraceSpan span{"write sorted rows", "output"};
+        if (!m_runs_file) {
+            // Everything fit in one run
+            std::sort(m_rows.begin(), m_rows.end());
+            for (const Row &r : m_rows) {
+                out.write(m_run.data() + r.offset + frame_size, r.size);
+            }
+            m_run.clear();
+            m_run.shrink_to_fit();
+            m_rows.clear();
+            m_rows.shrink_to_fit();
+            return;
+        }
+
+        if (!m_rows.empty()) {
+            write_run();
+        }
+        m_run.shrink_to_fit();
+        m_rows.shrink_to_fit();
+        m_runs_file->close();
+
+        const int fd = ::open(m_filename.c_str(), O_RDONLY | O_BINARY);
+        if (fd < 0) {
+            throw std::system_error{errno, std::system_category(),
+                                    "Can not open '" + m_filename + "'"};
+        }
+        try {
+            merge_runs(fd, out);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        m_runs.clear();
+        m_runs_file.reset();
+        std::remove(m_filename.c_str());
+    }
+};
+
+#endif // ROWSORTER_HPP
@@ -0,0 +1,119 @@
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "projection.hpp"
+#include "simplify.hpp"
+
+namespace {
+
+// Squared distance of point p from the segment a-b
+double segment_distance_squared(const double *p, const double *a,
+                                const double *b)
+{
+    const double dx = b[0] - a[0];
+    const double dy = b[1] - a[1];
+    double px = p[0] - a[0];
+    double py = p[1] - a[1];
+    const double length_squared = dx * dx + dy * dy;
+    if (length_squared > 0) {
+        // Closest point on the segment, as a fraction of its length
+        double t = (px * dx + py * dy) / length_squared;
+        t = t < 0 ? 0 : (t > 1 ? 1 : t);
+        px -= t * dx;
+        py -= t * dy;
+    }
+    return px * px + py * py;
+}
+
+} // anonymous namespace
+
+void LineSimplifier::set_points(const int32_t *x, const int32_t *y,
+                                size_t count)
+{
+    m_coordinates.resize(count * 2);
+    mercator_project(x, y, count, m_coordinates.data());
+    m_fixed.assign(count, false);
+    if (count > 0) {
+        m_fixed.front() = true;
+        m_fixed.back() = true;
+    }
+    m_tolerance = 0;
+}
+
+void LineSimplifier::simplify_section(uint32_t first, uint32_t last,
+                                      double tolerance)
+{
+    const double tolerance_squared = tolerance * tolerance;
+    m_sections.clear();
+    m_sections.emplace_back(first, last);
+    while (!m_sections.empty()) {
+        const auto section = m_sections.back();
+        m_sections.pop_back();
+
+        const double *a = &m_coordinates[section.first * 2];
+        const double *b = &m_coordinates[section.second * 2];
+        double max_distance = 0;
+        uint32_t farthest = 0;
+        for (uint32_t i = section.first + 1; i < section.second; ++i) {
+            const double distance =
+                segment_distance_squared(&m_coordinates[i * 2], a, b);
+            if (distance > max_distance) {
+                max_distance = distance;
+                farthest = i;
+            }
+        }
+
+        // The point farthest from the start of a closed section is always
+        // kept, so rings don't collapse to a single point
+        const bool closed = a[0] == b[0] && a[1] == b[1];
+        if (max_distance > tolerance_squared || (closed && farthest > 0)) {
+            m_kept[farthest] = true;
+            m_sections.emplace_back(section.first, farthest);
+            m_sections.emplace_back(farthest, section.second);
+        }
+    }
+}
+
+const std::vector<uint32_t> &LineSimplifier::simplify(double tolerance)
+{
+    if (tolerance == m_tolerance && tolerance > 0) {
+        return m_points;
+    }
+
+    const uint32_t count = static_cast<uint32_t>(m_fixed.size());
+    m_kept = m_fixed;
+    uint32_t first = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        if (m_fixed[i]) {
+            simplify_section(first, i, tolerance);
+            first = i;
+        }
+    }
+
+    m_points.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (m_kept[i]) {
+            m_points.push_back(i);
+        }
+    }
+    m_tolerance = tolerance;
+    return m_points;
+}
@@ -0,0 +1,71 @@
+#ifndef SIMPLIFY_HPP
+#define SIMPLIFY_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Douglas-Peucker simplification of linestrings in Web Mercator meters,
+ * the same units ST_Simplify uses on a 3857 table. Points can be fixed,
+ * which splits the line into sections that are simplified on their own,
+ * so points shared with other lines are never removed and simplified
+ * lines still connect.
+ *
+ * The buffers are reused from line to line, so one simplifier should be
+ * used for many lines, but only by one thread.
+ */
+class LineSimplifier
+{
+    // Web Mercator coordinates of the points as x,y pairs
+    std::vector<double> m_coordinates;
+    std::vector<bool> m_fixed;
+    std::vector<bool> m_kept;
+    std::vector<std::pair<uint32_t, uint32_t>> m_sections;
+    std::vector<uint32_t> m_points;
+    // Tolerance m_points was simplified with, 0 if it is out of date
+    double m_tolerance = 0;
+
+    void simplify_section(uint32_t first, uint32_t last, double tolerance);
+
+public:
+    /**
+     * Sets the points of the next line, given in osmium's fixed point
+     * format. Only the first and last point are fixed.
+     */
+    void set_points(const int32_t *x, const int32_t *y, size_t count);
+
+    /// Makes sure point index is kept by simplify()
+    void fix(size_t index) { m_fixed[index] = true; }
+
+    /**
+     * Returns the indices of the points kept with the given tolerance in
+     * meters, in line order. Simplifying with the same tolerance again
+     * returns the same result without doing the work again.
+     */
+    const std::vector<uint32_t> &simplify(double tolerance);
+};
+
+#endif // SIMPLIFY_HPP
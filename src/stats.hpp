@@ -22,16 +22,79 @@
 
 */
 
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <osmium/util/memory.hpp>
+
+/// Time and throughput of one pass over the input or of a later stage
+struct PassStats
+{
+    std::string name;
+    double wall_seconds;
+    double cpu_seconds;
+    /// Bytes read from the input file, compressed size for PBF
+    uint64_t bytes_read;
+    /// Objects read or processed
+    uint64_t objects;
+    /// Peak memory of the process at the end of the pass
+    int peak_memory_mb;
+};
+
+/**
+ * Measures a pass from construction to finish(). CPU time is that of the
+ * whole process, so it includes the threads of the osmium reader and of
+ * the geometry stage.
+ */
+class PassTimer
+{
+    std::chrono::steady_clock::time_point m_start;
+    std::clock_t m_cpu_start;
+
+public:
+    PassTimer()
+    : m_start(std::chrono::steady_clock::now()), m_cpu_start(std::clock())
+    {
+    }
+
+    PassStats finish(const std::string &name, uint64_t bytes_read,
+                     uint64_t objects) const
+    {
+        const std::chrono::duration<double> wall =
+            std::chrono::steady_clock::now() - m_start;
+        osmium::MemoryUsage memory;
+        return {name,
+                wall.count(),
+                static_cast<double>(std::clock() - m_cpu_start) /
+                    CLOCKS_PER_SEC,
+                bytes_read,
+                objects,
+                memory.peak()};
+    }
+};
+
 struct Stats
 {
-    unsigned int ways;
-    unsigned int unconnected_nodes;
-    unsigned int rings;
-    unsigned int rings_from_single_way;
-    unsigned int rings_fixed;
-    unsigned int rings_turned_around;
-    unsigned int land_polygons_before_split;
-    unsigned int land_polygons_after_split;
+    /// Boundary relations kept in pass 1 and their way members
+    uint64_t relations = 0;
+    uint64_t way_members = 0;
+    /// Member ways found in pass 2 and the nodes they reference
+    uint64_t ways = 0;
+    uint64_t nodes = 0;
+    /// Node locations stored in pass 3
+    uint64_t nodes_stored = 0;
+    /// Node references on member ways without a location
+    uint64_t missing_locations = 0;
+    /// Ways left out because no linestring could be built
+    uint64_t geometry_errors = 0;
+    /// Lines written to each output, by dividing_line + 2 * disputed +
+    /// 4 * maritime
+    uint64_t lines_by_flags[8] = {};
+
+    std::vector<PassStats> passes;
 };
 
 #endif // STATS_HPP
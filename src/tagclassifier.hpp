@@ -0,0 +1,85 @@
+#ifndef TAGCLASSIFIER_HPP
+#define TAGCLASSIFIER_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <bitset>
+#include <cstring>
+#include <vector>
+
+#include <osmium/osm/tag.hpp>
+
+/// Flags a way can get from its own tags
+enum way_flags : unsigned
+{
+    way_flag_disputed = 1u << 0,
+    way_flag_maritime = 1u << 1
+};
+
+/// A tag that sets flags on a way
+struct TagRule
+{
+    const char *key;
+    /// Value the tag must have, or nullptr if any value matches
+    const char *value;
+    unsigned flags;
+};
+
+/**
+ * Checks a tag list against a set of rules in one pass over the tags and
+ * returns the flags of all matching rules. Keys whose first character
+ * doesn't start any rule key are skipped with a single lookup, so most
+ * tags cost the same no matter how many rules there are.
+ */
+class TagClassifier
+{
+    std::vector<TagRule> m_rules;
+    std::bitset<256> m_first_chars;
+
+public:
+    explicit TagClassifier(const std::vector<TagRule> &rules) : m_rules(rules)
+    {
+        for (const auto &rule : m_rules) {
+            m_first_chars.set(static_cast<unsigned char>(rule.key[0]));
+        }
+    }
+
+    unsigned classify(const osmium::TagList &tags) const
+    {
+        unsigned flags = 0;
+        for (const auto &tag : tags) {
+            const char *key = tag.key();
+            if (!m_first_chars.test(static_cast<unsigned char>(key[0]))) {
+                continue;
+            }
+            for (const auto &rule : m_rules) {
+                if (!std::strcmp(rule.key, key) &&
+                    (!rule.value || !std::strcmp(rule.value, tag.value()))) {
+                    flags |= rule.flags;
+                }
+            }
+        }
+        return flags;
+    }
+};
+
+#endif // TAGCLASSIFIER_HPP
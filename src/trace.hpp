@@ -0,0 +1,145 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+/*
+
+  Copyright 2016 Paul Norman <penorman@mac.com>.
+
+  This file is part of OSMBorder.
+
+  OSMBorder is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OSMBorder is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OSMBorder.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Records timed spans for the Chrome trace event format, which can be
+ * viewed in chrome://tracing or Perfetto. Recording is off unless
+ * enable() is called, and a disabled span costs a single check.
+ *
+ * There is one tracer for the whole program, see tracer().
+ */
+class Tracer
+{
+public:
+    struct Event
+    {
+        // Static strings, they are written as they are
+        const char *name;
+        const char *category;
+        int64_t start_us;
+        int64_t duration_us;
+        unsigned int thread;
+    };
+
+    void enable() { m_enabled = true; }
+
+    bool enabled() const { return m_enabled; }
+
+    /// Microseconds since the tracer was created
+    int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - m_start)
+            .count();
+    }
+
+    /// Small number for the calling thread, the "tid" of its events
+    static unsigned int thread_number()
+    {
+        static std::atomic<unsigned int> next_thread{0};
+        thread_local const unsigned int number = next_thread++;
+        return number;
+    }
+
+    void add(const Event &event)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_events.push_back(event);
+    }
+
+    /// All recorded events as a trace event JSON document
+    std::string json() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        std::string out{"{\"traceEvents\":[\n"};
+        for (size_t i = 0; i < m_events.size(); ++i) {
+            const Event &event = m_events[i];
+            out += "{\"name\":\"";
+            out += event.name;
+            out += "\",\"cat\":\"";
+            out += event.category;
+            out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            out += std::to_string(event.thread);
+            out += ",\"ts\":";
+            out += std::to_string(event.start_us);
+            out += ",\"dur\":";
+            out += std::to_string(event.duration_us);
+            out += (i + 1 < m_events.size()) ? "},\n" : "}\n";
+        }
+        out += "],\"displayTimeUnit\":\"ms\"}\n";
+        return out;
+    }
+
+private:
+    bool m_enabled = false;
+    const std::chrono::steady_clock::time_point m_start =
+        std::chrono::steady_clock::now();
+    mutable std::mutex m_mutex;
+    std::vector<Event> m_events;
+};
+
+inline Tracer &tracer()
+{
+    static Tracer instance;
+    return instance;
+}
+
+/**
+ * Records the time from construction to destruction as a span if tracing
+ * is enabled. name and category must be string literals.
+ */
+class TraceSpan
+{
+    const char *m_name;
+    const char *m_category;
+    int64_t m_start;
+
+public:
+    TraceSpan(const char *name, const char *category)
+    : m_name(name), m_category(category),
+      m_start(tracer().enabled() ? tracer().now() : -1)
+    {
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    ~TraceSpan()
+    {
+        if (m_start >= 0) {
+            tracer().add({m_name, m_category, m_start,
+                          tracer().now() - m_start,
+                          Tracer::thread_number()});
+        }
+    }
+};
+
+#endif // TRACE_HPP
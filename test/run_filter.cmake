@@ -0,0 +1,62 @@
+#-----------------------------------------------------------------------------
+#
+#  Runs osmborder_filter with CHANGEFILE on INPUT and osmborder on the
+#  result. The filtered file is compared with EXPECTED_FILTERED, the
+#  osmborder output with EXPECTED.
+#
+#  Called by ctest with -DOSMBORDER_FILTER=... -DOSMBORDER=... -DINPUT=...
+#  -DCHANGEFILE=... -DOUTPUT=... -DEXPECTED_FILTERED=... -DEXPECTED=...
+#
+#-----------------------------------------------------------------------------
+
+execute_process(
+    COMMAND ${OSMBORDER_FILTER} -c ${CHANGEFILE} -o ${OUTPUT}.opl ${INPUT}
+    RESULT_VARIABLE result)
+
+if(result)
+    message(FATAL_ERROR "osmborder_filter returned ${result}")
+endif()
+
+# Only the IDs, tags, nodes and members are compared. Metadata and the
+# formatting of coordinates are up to the OPL writer.
+file(STRINGS ${OUTPUT}.opl lines)
+set(normalized "")
+foreach(line IN LISTS lines)
+    string(REPLACE " " ";" fields "${line}")
+    list(GET fields 0 kept)
+    list(REMOVE_AT fields 0)
+    foreach(field IN LISTS fields)
+        if(field MATCHES "^[TNM]")
+            set(kept "${kept} ${field}")
+        endif()
+    endforeach()
+    set(normalized "${normalized}${kept}\n")
+endforeach()
+file(WRITE ${OUTPUT}_normalized.opl "${normalized}")
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files
+        ${OUTPUT}_normalized.opl ${EXPECTED_FILTERED}
+    RESULT_VARIABLE result)
+
+if(result)
+    message(FATAL_ERROR
+        "${OUTPUT}_normalized.opl differs from ${EXPECTED_FILTERED}")
+endif()
+
+execute_process(
+    COMMAND ${OSMBORDER} --overwrite --output-file=${OUTPUT}.csv:4326
+        ${OUTPUT}.opl
+    RESULT_VARIABLE result)
+
+if(result)
+    message(FATAL_ERROR "osmborder returned ${result}")
+endif()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT}.csv ${EXPECTED}
+    RESULT_VARIABLE result)
+
+if(result)
+    message(FATAL_ERROR "${OUTPUT}.csv differs from ${EXPECTED}")
+endif()
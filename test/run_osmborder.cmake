@@ -0,0 +1,25 @@
+#-----------------------------------------------------------------------------
+#
+#  Runs osmborder on INPUT and compares OUTPUT with EXPECTED
+#
+#  Called by ctest with -DOSMBORDER=... -DINPUT=... -DOUTPUT=...
+#  -DEXPECTED=... -DEXPECTED_RESULT=...
+#
+#-----------------------------------------------------------------------------
+
+execute_process(
+    COMMAND ${OSMBORDER} --overwrite --output-file=${OUTPUT}:4326 ${INPUT}
+    RESULT_VARIABLE result)
+
+if(NOT result EQUAL EXPECTED_RESULT)
+    message(FATAL_ERROR
+        "osmborder returned ${result}, expected ${EXPECTED_RESULT}")
+endif()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+    RESULT_VARIABLE result)
+
+if(result)
+    message(FATAL_ERROR "${OUTPUT} differs from ${EXPECTED}")
+endif()